@@ -0,0 +1,343 @@
+#include "../Renderer/Renderer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Renders a model along a camera path into an image sequence, as many frames at once as there are workers: every worker is a headless
+// Application of its own, with its own back buffers and depth buffers, drawing and writing its frames on a single thread.
+// The model is loaded once and only read while the frames are drawn, so they all share it.
+//
+// Batch <model> <output directory> [--frames N] [--size WIDTHxHEIGHT] [--threads N] [--path FILE] [--format png|bmp|tga|jpg|qoi|bgr]
+//
+// Without a path the model spins once around the vertical axis through the center of its bounding box, in front of a fixed camera.
+// A path file has a camera key per line: "t px py pz rx ry rz", t going from 0 at the first frame to 1 at the last one, the position
+// and the rotation in degrees the same as Camera's. The camera moves in straight lines between keys, '#' starts a comment
+
+struct CameraKey
+{
+	float t = 0.0f;
+	Vec3f position;
+	Vec3f rotation;
+};
+
+struct BatchSettings
+{
+	std::filesystem::path model;
+	std::filesystem::path output;
+	std::filesystem::path path;
+	std::string format = "png";
+	size_t frames = 120;
+	size_t threads = 0; // one per hardware thread
+	uint16_t width = 1280;
+	uint16_t height = 720;
+};
+
+// what every frame of the sequence looks like, shared by the workers
+struct BatchJob
+{
+	const Object3D<Vertex>* model = nullptr;
+	std::vector<CameraKey> keys; // empty for a turntable
+	Vec3f center;                // of the model's bounding box
+	float radius = 1.0f;         // of a sphere around it
+	size_t frames = 0;
+	std::filesystem::path output;
+	std::string format;
+	std::atomic<size_t> failedWrites = 0;
+
+	void FrameAt(size_t frame, Camera& camera, Matrix4x4f& world) const noexcept
+	{
+		const float t = frames > 1 ? static_cast<float>(frame) / static_cast<float>(frames - 1) : 0.0f;
+
+		if (keys.empty())
+		{
+			// far enough for the whole bounding sphere to fit in a 90 degrees field of view, whichever way it's turned
+			camera.position = { center.x, center.y, center.z - radius * 1.5f };
+			camera.rotation = {};
+
+			const float angle = 360.0f * static_cast<float>(frame) / static_cast<float>(frames);
+			world = Translate(-center.x, -center.y, -center.z) * RotateY(angle) * Translate(center.x, center.y, center.z);
+			return;
+		}
+
+		world = Matrix4x4f::Identity();
+
+		size_t next = 0;
+		while (next < keys.size() && keys[next].t < t)
+		{
+			next++;
+		}
+
+		if (next == 0 || next == keys.size())
+		{
+			const CameraKey& key = keys[next == 0 ? 0 : keys.size() - 1];
+			camera.position = key.position;
+			camera.rotation = key.rotation;
+			return;
+		}
+
+		const CameraKey& a = keys[next - 1];
+		const CameraKey& b = keys[next];
+		const float s = b.t > a.t ? (t - a.t) / (b.t - a.t) : 1.0f;
+
+		camera.position = a.position + (b.position - a.position) * s;
+		camera.rotation = a.rotation + (b.rotation - a.rotation) * s;
+	}
+};
+
+// Draws frames first, first + step, first + 2 * step... of the job, one per OnUpdate
+class BatchWorker final : public Application
+{
+public:
+	BatchWorker(BatchJob& job, size_t first, size_t step) noexcept : m_job(job), m_first(first), m_step(step) {}
+
+	size_t FrameCount() const noexcept
+	{
+		return m_first < m_job.frames ? (m_job.frames - m_first + m_step - 1) / m_step : 0;
+	}
+
+	// the frame drawn by the nth OnUpdate, which is also the nth one presented
+	size_t Frame(size_t n) const noexcept
+	{
+		return m_first + n * m_step;
+	}
+
+	void OnInit() override
+	{
+		// the other workers already have every other core
+		SetRenderThreads(1);
+	}
+
+	void OnUpdate([[maybe_unused]] float dt) noexcept override
+	{
+		Matrix4x4f world;
+		m_job.FrameAt(Frame(m_updates++), m_camera, world);
+
+		m_camera.UpdateViewMatrix();
+		Draw3DObjectInstanced(*m_job.model, m_camera, &world, 1);
+	}
+
+	void WriteFrame(size_t n, const Color* pixels, size_t width, size_t height) noexcept
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%05zu.", Frame(n));
+
+		const RESULT_VALUE result = WriteImage(m_job.output / (name + m_job.format), pixels, width, height);
+		if (result != RESULT_VALUE::OK)
+		{
+			logResult(result);
+			m_job.failedWrites++;
+		}
+	}
+
+private:
+	BatchJob& m_job;
+	Camera m_camera;
+	size_t m_first;
+	size_t m_step;
+	size_t m_updates = 0;
+};
+
+static bool ReadCameraPath(const std::filesystem::path& path, std::vector<CameraKey>& keys)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "Couldn't open the camera path " << path << "\n";
+		return false;
+	}
+
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+		{
+			continue;
+		}
+
+		CameraKey key;
+		std::istringstream values(line);
+		if (!(values >> key.t >> key.position.x >> key.position.y >> key.position.z >> key.rotation.x >> key.rotation.y >> key.rotation.z))
+		{
+			std::cerr << path.string() << ":" << lineNumber << ": expected \"t px py pz rx ry rz\"\n";
+			return false;
+		}
+		keys.push_back(key);
+	}
+
+	std::stable_sort(keys.begin(), keys.end(), [](const CameraKey& l, const CameraKey& r) { return l.t < r.t; });
+	return true;
+}
+
+// a whole decimal number in [min, max], nothing else
+static bool ParseNumber(std::string_view text, size_t min, size_t max, size_t& value)
+{
+	const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	return error == std::errc() && end == text.data() + text.size() && value >= min && value <= max;
+}
+
+static bool ParseArguments(int argc, char** argv, BatchSettings& settings)
+{
+	static constexpr std::string_view FORMATS[] = { "png", "bmp", "tga", "jpg", "jpeg", "qoi", "bgr" };
+
+	if (argc < 3 || (argc - 3) % 2 != 0)
+	{
+		return false;
+	}
+
+	settings.model = argv[1];
+	settings.output = argv[2];
+
+	for (int i = 3; i + 1 < argc; i += 2)
+	{
+		const std::string_view option = argv[i];
+		const std::string_view value = argv[i + 1];
+
+		if (option == "--frames")
+		{
+			if (!ParseNumber(value, 1, 10'000'000, settings.frames))
+			{
+				return false;
+			}
+		}
+		else if (option == "--threads")
+		{
+			if (!ParseNumber(value, 0, 1024, settings.threads))
+			{
+				return false;
+			}
+		}
+		else if (option == "--path")
+		{
+			settings.path = value;
+		}
+		else if (option == "--format")
+		{
+			// checked here, otherwise every frame would be rendered only to fail being written
+			if (std::find(std::begin(FORMATS), std::end(FORMATS), value) == std::end(FORMATS))
+			{
+				return false;
+			}
+			settings.format = value;
+		}
+		else if (option == "--size")
+		{
+			const size_t separator = value.find('x');
+			size_t width = 0, height = 0;
+
+			if (separator == std::string_view::npos || !ParseNumber(value.substr(0, separator), 1, UINT16_MAX, width) ||
+				!ParseNumber(value.substr(separator + 1), 1, UINT16_MAX, height))
+			{
+				return false;
+			}
+			settings.width = static_cast<uint16_t>(width);
+			settings.height = static_cast<uint16_t>(height);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BatchSettings settings;
+	if (!ParseArguments(argc, argv, settings))
+	{
+		std::cerr << "Batch <model> <output directory> [--frames N] [--size WIDTHxHEIGHT] [--threads N] [--path FILE] [--format png|bmp|tga|jpg|qoi|bgr]\n";
+		return 1;
+	}
+
+	BatchJob job;
+	job.frames = settings.frames;
+	job.output = settings.output;
+	job.format = settings.format;
+
+	if (!settings.path.empty() && !ReadCameraPath(settings.path, job.keys))
+	{
+		return 1;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(settings.output, error);
+
+	const size_t threads = settings.threads != 0 ? settings.threads : std::max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t workerCount = std::min(threads, settings.frames);
+
+	// There's one Allocator for the whole process, initialized here for the model and the buffers of every worker.
+	// Start sees it's already there and only takes its buffers from it. 64 entries per worker is several times the buffers it allocates
+	const size_t workerMemory = Application::CanvasBufferBytes(settings.width, settings.height);
+	logResult(Allocator::Init(MB(256) + workerCount * workerMemory, 64, 4096 + workerCount * 64));
+
+	Object3D<Vertex> model;
+	const RESULT_VALUE loaded = model.LoadFromFile(settings.model);
+	if (model.meshArr.size() == 0)
+	{
+		logResult(loaded);
+		return 1;
+	}
+	job.model = &model;
+
+	Vec3f min = { 1e30f, 1e30f, 1e30f };
+	Vec3f max = { -1e30f, -1e30f, -1e30f };
+	for (size_t i = 0; i < model.collisionBoxes.size(); i++)
+	{
+		const AABB& box = model.collisionBoxes[i];
+		min = { std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z) };
+		max = { std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z) };
+	}
+	job.center = (min + max) * 0.5f;
+	job.radius = std::max(0.5f * std::sqrt(dot(max - min, max - min)), 1e-3f);
+
+	// frames are dealt round robin, neighbouring frames cost about the same so every worker gets about the same work
+	std::vector<std::unique_ptr<BatchWorker>> workers;
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::make_unique<BatchWorker>(job, i, workerCount));
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threadsRunning;
+	for (const std::unique_ptr<BatchWorker>& worker : workers)
+	{
+		threadsRunning.emplace_back([&settings, &worker]()
+			{
+				Platform::HeadlessOptions options;
+				options.frameCount = worker->FrameCount();
+				options.onFrame = [&worker](size_t n, const Color* pixels, size_t width, size_t height)
+					{
+						worker->WriteFrame(n, pixels, width, height);
+					};
+
+				logResult(worker->Start(std::move(options), settings.width, settings.height));
+			});
+	}
+
+	for (std::thread& thread : threadsRunning)
+	{
+		thread.join();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << settings.frames << " frames of " << workers[0]->CanvasWidth() << "x" << workers[0]->CanvasHeight() << " on " << workerCount << " threads in "
+		<< elapsed.count() << " s, " << (double)settings.frames / elapsed.count() << " frames/s\n";
+
+	return job.failedWrites == 0 ? 0 : 1;
+}
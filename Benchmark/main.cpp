@@ -0,0 +1,583 @@
+#include "../Renderer/Transform.hpp"
+#include "../Renderer/Object3D.hpp"
+#include "../Renderer/Clipping.hpp"
+#include "../Renderer/Rasterizer.hpp"
+#include "../Renderer/Random.hpp"
+#include "../Renderer/Stream.hpp"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Micro benchmarks for the hot paths of the renderer, run it on a Release build.
+// Every benchmark prints how many elements it processes per second, so the numbers can be compared between machines and commits
+
+static constexpr size_t REPETITIONS = 50;
+
+// runs work REPETITIONS times and returns the best time in seconds, the best run is the one least disturbed by the rest of the system
+static double Measure(const std::function<void()>& work) noexcept
+{
+	double best = 1e30;
+	for (size_t i = 0; i < REPETITIONS; i++)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		work();
+		const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		best = elapsed.count() < best ? elapsed.count() : best;
+	}
+	return best;
+}
+
+static void Report(std::string_view name, size_t elements, double seconds) noexcept
+{
+	std::cout << name << ": " << (double)elements / seconds / 1e6 << " M/s (" << seconds * 1e3 << " ms)\n";
+}
+
+static void BenchmarkTransform() noexcept
+{
+	static constexpr size_t POINTS = 1 << 16; // about the size of a detailed mesh, small enough to stay in cache
+
+	const Matrix4x4f mat = SRT(Scale(2.0f, 2.0f, 2.0f), Rotate(0.3f, 0.5f, 0.7f), Translate(0.0f, 1.0f, 10.0f)) * ProjectionMatrix(800, 600, 90.0f, 0.1f, 1000.0f);
+
+	PointStreams in;
+	in.Resize(POINTS);
+	std::vector<Vec3f> interleaved(POINTS);
+	for (size_t i = 0; i < POINTS; i++)
+	{
+		in.x[i] = RANDOM::RandomValue((uint32_t)(i * 3)) * 20.0f - 10.0f;
+		in.y[i] = RANDOM::RandomValue((uint32_t)(i * 3 + 1)) * 20.0f - 10.0f;
+		in.z[i] = RANDOM::RandomValue((uint32_t)(i * 3 + 2)) * 20.0f - 10.0f;
+		interleaved[i] = in.At(i);
+	}
+
+	// the scalar operator divides by w and has no outcode, computing one here would only make it look worse
+	std::vector<Vec3f> scalarOut(POINTS);
+	const double scalar = Measure([&]()
+		{
+			for (size_t i = 0; i < POINTS; i++)
+			{
+				scalarOut[i] = mat * interleaved[i];
+			}
+		});
+
+	ClipStreams batchOut;
+	batchOut.Resize(POINTS);
+	const double batch = Measure([&]() { TransformPoints(mat, in, batchOut); });
+
+	// both paths must agree, otherwise the comparison means nothing
+	float maxError = 0.0f;
+	for (size_t i = 0; i < POINTS; i++)
+	{
+		const Vec4f clip = batchOut.At(i);
+		const float error = fabsf(clip.x / clip.w - scalarOut[i].x) / (1.0f + fabsf(scalarOut[i].x));
+		maxError = error > maxError ? error : maxError;
+	}
+
+	Report("Matrix4x4f * Vec3f", POINTS, scalar);
+	Report("TransformPoints (+ outcodes)", POINTS, batch);
+	std::cout << "speed up: " << scalar / batch << "x, max relative error: " << maxError << "\n\n";
+}
+
+// Depth only rasterization of a pile of overlapping triangles in no particular depth order, with and without the hierarchical z.
+// The triangles are the same size at random positions and depths, so every pixel is covered many times over
+static void BenchmarkHiZ() noexcept
+{
+	static constexpr size_t WIDTH = 800;
+	static constexpr size_t HEIGHT = 600;
+	static constexpr size_t TRIANGLES = 20000;
+	static constexpr float SIZE = 60.0f;
+
+	// a generator of its own, seeded the same on every run so the scene is too
+	std::minstd_rand generator(1);
+	std::uniform_real_distribution<float> toX(0.0f, WIDTH - SIZE);
+	std::uniform_real_distribution<float> toY(0.0f, HEIGHT - SIZE);
+	std::uniform_real_distribution<float> toZ(0.05f, 0.95f);
+
+	std::vector<RasterTriangle> triangles(TRIANGLES);
+	double area = 0.0;
+	for (size_t i = 0; i < TRIANGLES; i++)
+	{
+		const float x = toX(generator);
+		const float y = toY(generator);
+		const float z = toZ(generator);
+
+		triangles[i] = { { x, y, z, 1.0f, 0.0f, 0.0f }, { x, y + SIZE, z, 1.0f, 0.0f, 1.0f }, { x + SIZE, y, z, 1.0f, 1.0f, 0.0f } };
+		area += 0.5 * SIZE * SIZE;
+	}
+
+	std::vector<unsigned short> depth(WIDTH * HEIGHT);
+	std::vector<unsigned short> blockDepth(HiZBlockCount(WIDTH, HEIGHT));
+	std::vector<unsigned short> tileDepth(HiZTileCount(WIDTH, HEIGHT));
+	const ScissorRect screen = { 0, 0, (int32_t)WIDTH, (int32_t)HEIGHT };
+
+	RenderTarget target;
+	target.depth = depth.data();
+	target.width = WIDTH;
+	target.height = HEIGHT;
+
+	std::vector<unsigned short> results[2];
+	double times[2] = {};
+
+	for (size_t h = 0; h < 2; h++)
+	{
+		target.blockDepth = h == 1 ? blockDepth.data() : nullptr;
+		target.tileDepth = h == 1 ? tileDepth.data() : nullptr;
+
+		// the hierarchical z is cleared along with the depth buffer, as the renderer does every frame
+		times[h] = Measure([&]()
+			{
+				std::fill(depth.begin(), depth.end(), (unsigned short)0xFFFF);
+				std::fill(blockDepth.begin(), blockDepth.end(), (unsigned short)0xFFFF);
+				std::fill(tileDepth.begin(), tileDepth.end(), (unsigned short)0xFFFF);
+				for (const RasterTriangle& triangle : triangles)
+				{
+					RasterizeTriangle(target, triangle, screen);
+				}
+			});
+
+		results[h] = depth;
+	}
+
+	std::cout << TRIANGLES << " triangles covering every pixel " << area / (double)(WIDTH * HEIGHT) << " times on average\n";
+	Report("depth only raster", TRIANGLES, times[0]);
+	Report("depth only raster, hierarchical z", TRIANGLES, times[1]);
+	std::cout << "speed up: " << times[0] / times[1] << "x, same depth buffer: " << (results[0] == results[1] ? "yes" : "no") << "\n\n";
+}
+
+// vertices over and over until there are count of them
+template <minVertex vertexType>
+static bool ReplicateVertices(const A::array<vertexType>& vertices, size_t count, A::array<vertexType>& out)
+{
+	if (vertices.size() == 0 || !A::array<vertexType>::make_array(out, count))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		out.emplace_back(vertices[i % vertices.size()]);
+	}
+	return true;
+}
+
+// the geometry stage of a mesh drawn once, each vertex read a single time: staging, the batch transform and reading its uv back
+template <minVertex vertexType>
+static float StageAndTransform(const A::array<vertexType>& vertices, const Matrix4x4f& mat, PointStreams& staged, ClipStreams& clip)
+{
+	StagePositions(vertices, staged);
+	TransformPoints(mat, staged, clip);
+
+	float uvSum = 0.0f;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vec2f uv = vertices[i].uv;
+		uvSum += uv.x + uv.y;
+	}
+	return uvSum;
+}
+
+// The per mesh work of the geometry stage on a real model, with the vertices interleaved, as streams and as PackedVertex: getting the
+// positions to the batch transform, transforming them, then reading the uv of every triangle corner the way the triangle assembly does
+static void BenchmarkMeshLayout() noexcept
+{
+	static constexpr const char* MODEL = "../bird-orange/BirdOrange.fbx";
+
+	LoadOptions options;
+	options.lodLevels = 0;
+	options.meshlets = false;
+
+	Object3D<Vertex> interleaved;
+	Object3D<Vertex> streamed;
+	Object3D<PackedVertex> packed;
+
+	options.layout = MeshLayout::INTERLEAVED;
+	const RESULT_VALUE interleavedResult = interleaved.LoadFromFile(MODEL, options);
+	const RESULT_VALUE packedResult = packed.LoadFromFile(MODEL, options);
+	options.layout = MeshLayout::STREAMS;
+	const RESULT_VALUE streamedResult = streamed.LoadFromFile(MODEL, options);
+
+	// a missing texture still leaves the geometry, which is all this needs
+	if (interleaved.meshArr.size() == 0 || streamed.meshArr.size() == 0 || packed.meshArr.size() == 0)
+	{
+		logResult(interleavedResult != RESULT_VALUE::OK ? interleavedResult : streamedResult != RESULT_VALUE::OK ? streamedResult : packedResult);
+		std::cout << "mesh layout: couldn't load " << MODEL << ", skipped\n\n";
+		return;
+	}
+
+	const Matrix4x4f mat = SRT(Scale(1.0f, 1.0f, 1.0f), Rotate(0.3f, 0.5f, 0.7f), Translate(0.0f, 0.0f, 50.0f)) * ProjectionMatrix(800, 600, 90.0f, 0.1f, 1000.0f);
+
+	size_t vertices = 0;
+	for (size_t i = 0; i < interleaved.meshArr.size(); i++)
+	{
+		vertices += interleaved.meshArr[i].vertices.size();
+	}
+
+	PointStreams staged;
+	ClipStreams clip;
+	float uvSum = 0.0f; // keeps the uv reads from being optimized away
+
+	const double aos = Measure([&]()
+		{
+			for (size_t i = 0; i < interleaved.meshArr.size(); i++)
+			{
+				const Mesh<Vertex>& mesh = interleaved.meshArr[i];
+				StagePositions(mesh.vertices, staged);
+				TransformPoints(mat, staged, clip);
+
+				mesh.VisitIndices([&](const auto* indices) noexcept
+					{
+						for (size_t j = 0; j < mesh.IndexCount(); j++)
+						{
+							const Vec2f uv = mesh.vertices[indices[j]].uv;
+							uvSum += uv.x + uv.y;
+						}
+					});
+			}
+		});
+
+	const double soa = Measure([&]()
+		{
+			for (size_t i = 0; i < streamed.meshArr.size(); i++)
+			{
+				const Mesh<Vertex>& mesh = streamed.meshArr[i];
+				const VertexStreams& streams = mesh.streams;
+				TransformPoints(mat, &streams.x[0], &streams.y[0], &streams.z[0], streams.Size(), clip);
+
+				mesh.VisitIndices([&](const auto* indices) noexcept
+					{
+						for (size_t j = 0; j < mesh.IndexCount(); j++)
+						{
+							uvSum += streams.u[indices[j]] + streams.v[indices[j]];
+						}
+					});
+			}
+		});
+
+	// the integer positions are staged as they are, the dequantization goes in the matrix like in the geometry stage
+	const double quantized = Measure([&]()
+		{
+			for (size_t i = 0; i < packed.meshArr.size(); i++)
+			{
+				const Mesh<PackedVertex>& mesh = packed.meshArr[i];
+				StagePositions(mesh.vertices, staged);
+				TransformPoints(mesh.Dequantization() * mat, staged, clip);
+
+				mesh.VisitIndices([&](const auto* indices) noexcept
+					{
+						for (size_t j = 0; j < mesh.IndexCount(); j++)
+						{
+							const Vec2f uv = mesh.vertices[indices[j]].uv;
+							uvSum += uv.x + uv.y;
+						}
+					});
+			}
+		});
+
+	Report("BirdOrange, interleaved vertices", vertices, aos);
+	Report("BirdOrange, vertex streams", vertices, soa);
+	Report("BirdOrange, packed vertices", vertices, quantized);
+	std::cout << "speed up, streams: " << aos / soa << "x, packed: " << aos / quantized << "x (" << uvSum << ")\n\n";
+
+	// The bird fits in the caches, where halving the vertex only adds the conversions. Its biggest mesh copied over and over
+	// into REPLICATED vertices doesn't, and staging them reads the whole vertex array from memory on every draw
+	static constexpr size_t REPLICATED = 4'000'000;
+
+	size_t biggest = 0;
+	for (size_t i = 1; i < interleaved.meshArr.size(); i++)
+	{
+		biggest = interleaved.meshArr[i].vertices.size() > interleaved.meshArr[biggest].vertices.size() ? i : biggest;
+	}
+
+	const Mesh<Vertex>& fullMesh = interleaved.meshArr[biggest];
+	const Mesh<PackedVertex>& packedMesh = packed.meshArr[biggest];
+	const Matrix4x4f packedMat = packedMesh.Dequantization() * mat;
+
+	// one at a time, the packed copy takes the memory the full one gives back
+	double large[2] = {};
+	{
+		A::array<Vertex> copies;
+		if (!ReplicateVertices(fullMesh.vertices, REPLICATED, copies))
+		{
+			std::cout << "mesh layout: couldn't allocate " << REPLICATED << " vertices, skipped\n\n";
+			return;
+		}
+		large[0] = Measure([&]() { uvSum += StageAndTransform(copies, mat, staged, clip); });
+	}
+	{
+		A::array<PackedVertex> copies;
+		if (!ReplicateVertices(packedMesh.vertices, REPLICATED, copies))
+		{
+			std::cout << "mesh layout: couldn't allocate " << REPLICATED << " packed vertices, skipped\n\n";
+			return;
+		}
+		large[1] = Measure([&]() { uvSum += StageAndTransform(copies, packedMat, staged, clip); });
+	}
+
+	Report("BirdOrange x many, interleaved vertices", REPLICATED, large[0]);
+	Report("BirdOrange x many, packed vertices", REPLICATED, large[1]);
+	std::cout << "speed up, packed: " << large[0] / large[1] << "x (" << uvSum << ")\n\n";
+}
+
+// Front facing triangles of every mesh entirely inside of the frustum, in the order of the indices, as the rasterizer gets them
+static std::vector<RasterTriangle> ProjectTriangles(const Object3D<Vertex>& object, const Matrix4x4f& toClip, size_t width, size_t height)
+{
+	const Matrix4x4f viewPort = ViewPortMatrix(width, height);
+	std::vector<RasterTriangle> triangles;
+	PointStreams staged;
+	ClipStreams clip;
+
+	for (size_t i = 0; i < object.meshArr.size(); i++)
+	{
+		const Mesh<Vertex>& mesh = object.meshArr[i];
+		StagePositions(mesh.vertices, staged);
+		TransformPoints(toClip, staged, clip);
+
+		const auto toRaster = [&](uint32_t index) noexcept -> RasterVertex
+			{
+				const float invW = 1.0f / clip.w[index];
+				const Vec3f screen = viewPort * Vec3f{ clip.x[index] * invW, clip.y[index] * invW, clip.z[index] * invW };
+				return { screen.x, screen.y, screen.z, invW, mesh.vertices[index].uv.x, mesh.vertices[index].uv.y };
+			};
+
+		mesh.VisitIndices([&](const auto* indices)
+			{
+				for (size_t j = 0; j + 2 < mesh.IndexCount(); j += 3)
+				{
+					const uint32_t a = indices[j], b = indices[j + 1], c = indices[j + 2];
+
+					if ((clip.outcode[a] | clip.outcode[b] | clip.outcode[c]) != 0 || IsBackFacing(clip.At(a), clip.At(b), clip.At(c)))
+					{
+						continue;
+					}
+
+					triangles.push_back({ toRaster(a), toRaster(b), toRaster(c) });
+				}
+			});
+	}
+
+	return triangles;
+}
+
+// The bird loaded with and without OptimizeMeshOrder: misses of a REORDER_CACHE_SIZE vertex cache per triangle, the geometry stage
+// as in BenchmarkMeshLayout with the clip space positions of every corner read back, and how many times the pixels get drawn over
+static void BenchmarkMeshOrder() noexcept
+{
+	static constexpr const char* MODEL = "../bird-orange/BirdOrange.fbx";
+	static constexpr size_t WIDTH = 800;
+	static constexpr size_t HEIGHT = 600;
+
+	LoadOptions options;
+	options.lodLevels = 0;
+	options.meshlets = false;
+
+	Object3D<Vertex> objects[2];
+	const char* names[2] = { "BirdOrange, as imported", "BirdOrange, OptimizeMeshOrder" };
+
+	for (size_t o = 0; o < 2; o++)
+	{
+		options.reorder = o == 1;
+		const RESULT_VALUE result = objects[o].LoadFromFile(MODEL, options);
+
+		if (objects[o].meshArr.size() == 0)
+		{
+			logResult(result);
+			std::cout << "mesh order: couldn't load " << MODEL << ", skipped\n\n";
+			return;
+		}
+	}
+
+	// the whole model fills most of the screen, so every triangle gets drawn
+	Vec3f min = { 1e30f, 1e30f, 1e30f };
+	Vec3f max = { -1e30f, -1e30f, -1e30f };
+	for (size_t i = 0; i < objects[0].collisionBoxes.size(); i++)
+	{
+		const AABB& box = objects[0].collisionBoxes[i];
+		min = { std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z) };
+		max = { std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z) };
+	}
+	const Vec3f center = (min + max) * 0.5f;
+	const Vec3f extent = max - min;
+	const float radius = std::max(0.5f * std::sqrt(dot(extent, extent)), 1e-6f);
+
+	const Matrix4x4f mat = Translate(-center.x, -center.y, -center.z) * SRT(Scale(1.0f / radius, 1.0f / radius, 1.0f / radius), Rotate(0.3f, 0.5f, 0.7f), Translate(0.0f, 0.0f, 2.5f))
+		* ProjectionMatrix(WIDTH, HEIGHT, 90.0f, 0.1f, 1000.0f);
+
+	std::vector<unsigned short> depth(WIDTH * HEIGHT);
+	std::vector<unsigned short> before;
+	RenderTarget target;
+	target.depth = depth.data();
+	target.width = WIDTH;
+	target.height = HEIGHT;
+	const ScissorRect screen = { 0, 0, (int32_t)WIDTH, (int32_t)HEIGHT };
+
+	double times[2][2] = {};
+
+	for (size_t o = 0; o < 2; o++)
+	{
+		const Object3D<Vertex>& object = objects[o];
+
+		size_t triangleCount = 0;
+		size_t vertexCount = 0;
+		float misses = 0.0f;
+		for (size_t i = 0; i < object.meshArr.size(); i++)
+		{
+			const Mesh<Vertex>& mesh = object.meshArr[i];
+			std::vector<uint32_t> indices(mesh.IndexCount());
+			mesh.VisitIndices([&](const auto* meshIndices) noexcept { std::copy(meshIndices, meshIndices + indices.size(), indices.begin()); });
+
+			misses += AverageCacheMissRatio(indices.data(), indices.size(), mesh.VertexCount()) * (float)(indices.size() / 3);
+			triangleCount += indices.size() / 3;
+			vertexCount += mesh.VertexCount();
+		}
+
+		PointStreams staged;
+		ClipStreams clip;
+		float sum = 0.0f; // keeps the reads from being optimized away
+
+		times[o][0] = Measure([&]()
+			{
+				for (size_t i = 0; i < object.meshArr.size(); i++)
+				{
+					const Mesh<Vertex>& mesh = object.meshArr[i];
+					StagePositions(mesh.vertices, staged);
+					TransformPoints(mat, staged, clip);
+
+					mesh.VisitIndices([&](const auto* indices) noexcept
+						{
+							for (size_t j = 0; j < mesh.IndexCount(); j++)
+							{
+								sum += clip.x[indices[j]] + clip.w[indices[j]] + mesh.vertices[indices[j]].uv.x;
+							}
+						});
+				}
+			});
+
+		// a pixel was drawn when a triangle changed its depth, which only misses the odd write of the depth already there
+		const std::vector<RasterTriangle> triangles = ProjectTriangles(object, mat, WIDTH, HEIGHT);
+		std::fill(depth.begin(), depth.end(), (unsigned short)0xFFFF);
+		size_t drawn = 0;
+
+		for (const RasterTriangle& triangle : triangles)
+		{
+			const ScissorRect bounds =
+			{
+				std::max(0, (int32_t)std::floor(std::min({ triangle.a.x, triangle.b.x, triangle.c.x }))),
+				std::max(0, (int32_t)std::floor(std::min({ triangle.a.y, triangle.b.y, triangle.c.y }))),
+				std::min((int32_t)WIDTH, (int32_t)std::ceil(std::max({ triangle.a.x, triangle.b.x, triangle.c.x })) + 1),
+				std::min((int32_t)HEIGHT, (int32_t)std::ceil(std::max({ triangle.a.y, triangle.b.y, triangle.c.y })) + 1)
+			};
+
+			before.clear();
+			for (int32_t y = bounds.minY; y < bounds.maxY; y++)
+			{
+				before.insert(before.end(), depth.begin() + y * WIDTH + bounds.minX, depth.begin() + y * WIDTH + bounds.maxX);
+			}
+
+			RasterizeTriangle(target, triangle, bounds);
+
+			size_t k = 0;
+			for (int32_t y = bounds.minY; y < bounds.maxY; y++)
+			{
+				for (int32_t x = bounds.minX; x < bounds.maxX; x++)
+				{
+					drawn += depth[y * WIDTH + x] != before[k++];
+				}
+			}
+		}
+
+		const size_t covered = (size_t)std::count_if(depth.begin(), depth.end(), [](unsigned short d) { return d != 0xFFFF; });
+
+		times[o][1] = Measure([&]()
+			{
+				std::fill(depth.begin(), depth.end(), (unsigned short)0xFFFF);
+				for (const RasterTriangle& triangle : triangles)
+				{
+					RasterizeTriangle(target, triangle, screen);
+				}
+			});
+
+		std::cout << names[o] << ": " << triangleCount << " triangles, " << vertexCount << " vertices, " << misses / (float)triangleCount
+			<< " cache misses per triangle, every pixel drawn " << (double)drawn / (double)covered << " times (" << sum << ")\n";
+		Report("  geometry", vertexCount, times[o][0]);
+		Report("  depth only raster", triangles.size(), times[o][1]);
+	}
+
+	std::cout << "speed up: geometry " << times[0][0] / times[1][0] << "x, raster " << times[0][1] / times[1][1] << "x\n\n";
+}
+
+// BT.601 limited range 4:2:0 a pixel at a time, the plain loop ConvertToYUV420 has to give the same bytes as
+static void ConvertToYUV420Scalar(const Color* pixels, size_t width, size_t height, uint8_t* out) noexcept
+{
+	uint8_t* planeU = out + width * height;
+	uint8_t* planeV = planeU + (width / 2) * (height / 2);
+
+	for (size_t i = 0; i < width * height; i++)
+	{
+		out[i] = static_cast<uint8_t>(((66 * pixels[i].red + 129 * pixels[i].green + 25 * pixels[i].blue + 128) >> 8) + 16);
+	}
+
+	for (size_t y = 0; y < height; y += 2)
+	{
+		for (size_t x = 0; x < width; x += 2)
+		{
+			int32_t r = 0, g = 0, b = 0;
+			for (const Color& pixel : { pixels[y * width + x], pixels[y * width + x + 1], pixels[(y + 1) * width + x], pixels[(y + 1) * width + x + 1] })
+			{
+				r += pixel.red;
+				g += pixel.green;
+				b += pixel.blue;
+			}
+
+			// the sums of 4 pixels, so 2 more bits to shift away
+			planeU[(y / 2) * (width / 2) + x / 2] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+			planeV[(y / 2) * (width / 2) + x / 2] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+		}
+	}
+}
+
+// what presenting costs on top of the window when a frame is also streamed as BGR24 (a copy) or Y4M (ConvertToYUV420), at 1080p
+static void BenchmarkFrameOutput() noexcept
+{
+	static constexpr size_t WIDTH = 1920;
+	static constexpr size_t HEIGHT = 1080;
+
+	// gradients with a bit of noise, closer to a rendered frame than noise alone
+	std::vector<Color> frame(WIDTH * HEIGHT);
+	for (size_t y = 0; y < HEIGHT; y++)
+	{
+		for (size_t x = 0; x < WIDTH; x++)
+		{
+			const uint8_t noise = static_cast<uint8_t>(RANDOM::RandomInterval(0.0f, 16.0f));
+			frame[y * WIDTH + x] = Color(static_cast<uint8_t>(x * 200 / WIDTH + noise), static_cast<uint8_t>(y * 200 / HEIGHT + noise), static_cast<uint8_t>(noise * 8));
+		}
+	}
+
+	std::vector<uint8_t> out(WIDTH * HEIGHT * sizeof(Color));
+	std::vector<uint8_t> reference(WIDTH * HEIGHT * 3 / 2);
+
+	Report("frame copy (BGR24)", WIDTH * HEIGHT, Measure([&]() { std::memcpy(out.data(), frame.data(), WIDTH * HEIGHT * sizeof(Color)); }));
+
+	const double scalar = Measure([&]() { ConvertToYUV420Scalar(frame.data(), WIDTH, HEIGHT, reference.data()); });
+	const double simd = Measure([&]() { ConvertToYUV420(frame.data(), WIDTH, HEIGHT, false, out.data()); });
+
+	Report("frame to YUV 4:2:0, a pixel at a time", WIDTH * HEIGHT, scalar);
+	Report("frame to YUV 4:2:0 (Y4M)", WIDTH * HEIGHT, simd);
+	std::cout << "speed up: " << scalar / simd << "x, same bytes: " << (std::equal(reference.begin(), reference.end(), out.begin()) ? "yes" : "no") << "\n\n";
+}
+
+int main()
+{
+	logResult(Allocator::Init(MB(256)));
+
+	BenchmarkTransform();
+	BenchmarkHiZ();
+	BenchmarkMeshLayout();
+	BenchmarkMeshOrder();
+	BenchmarkFrameOutput();
+
+	return 0;
+}
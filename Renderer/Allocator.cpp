@@ -47,6 +47,8 @@ void Allocator::Resize(size_t newSize, size_t alignment)
 
 RESULT_VALUE Allocator::Allocate(void*& ptr, size_t amount)
 {
+	const std::lock_guard lock(m_mutex);
+
 	if (m_allocated == 0 || m_allocated == sizeof(AddressRegistry) * m_registry.capacity)
 	{
 		return RESULT_VALUE::ALLOCATOR_NOT_INITIALIZED;
@@ -97,6 +99,8 @@ RESULT_VALUE Allocator::Allocate(void*& ptr, size_t amount)
 
 void Allocator::Free(void*& ptr)
 {
+	const std::lock_guard lock(m_mutex);
+
 	const size_t offsetIntoBuffer = reinterpret_cast<size_t>(ptr) - reinterpret_cast<size_t>(m_buffer);
 
 	for (size_t i = 0; i < m_registry.size; i++)
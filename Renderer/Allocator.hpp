@@ -3,6 +3,7 @@
 
 #include "ErrorEnum.hpp"
 #include <atomic>
+#include <mutex>
 
 static constexpr size_t KB(size_t val) { return val * 1024; }
 static constexpr size_t MB(size_t val) { return KB(val) * 1024; }
@@ -19,7 +20,9 @@ public:
 	~Allocator();
 
 	static RESULT_VALUE Init(size_t bufferSize, size_t alignment = 64, size_t maxElements = 4096);
+	static bool IsInitialized() noexcept { return m_buffer != nullptr; }
 	static void Resize(size_t newSize, size_t alignment = 64);
+	// both can be called from any thread, e.g. several Applications rendering side by side
 	static RESULT_VALUE Allocate(void*& ptr, size_t bytes = 0);
 	static void Free(void*& ptr);
 
@@ -43,6 +46,7 @@ private:
 	inline static std::atomic<size_t> m_consumed = 0;
 
 	inline static AddressRegistry m_registry;
+	inline static std::mutex m_mutex; // of Allocate and Free
 };
 
 namespace A
@@ -0,0 +1,140 @@
+#include "Capture.hpp"
+#include "Images.hpp"
+#include <cstdio>
+#include <cstring>
+
+FrameCapture::FrameCapture(size_t width, size_t height, CaptureOptions options) : m_width(width), m_height(height), m_options(std::move(options))
+{
+	m_options.slotCount = m_options.slotCount == 0 ? 1 : m_options.slotCount;
+
+	const size_t encoderCount = m_options.encoderThreads != 0 ? m_options.encoderThreads : std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	m_slots.resize(m_options.slotCount * width * height);
+	m_filled.resize(m_options.slotCount);
+	m_free.reserve(m_options.slotCount);
+
+	// the lowest slots are handed out first
+	for (size_t i = m_options.slotCount; i > 0; i--)
+	{
+		m_free.push_back(i - 1);
+	}
+
+	m_encoders.reserve(encoderCount);
+	for (size_t i = 0; i < encoderCount; i++)
+	{
+		m_encoders.emplace_back([this]() { EncoderLoop(); });
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	Finish();
+}
+
+void FrameCapture::Finish() noexcept
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_slotFilled.notify_all();
+
+	for (std::thread& encoder : m_encoders)
+	{
+		encoder.join();
+	}
+	m_encoders.clear();
+}
+
+bool FrameCapture::Submit(const Color* pixels, bool invertY) noexcept
+{
+	size_t slot = 0;
+	size_t frame = 0;
+	{
+		std::unique_lock lock(m_mutex);
+
+		if (m_free.empty())
+		{
+			if (m_options.policy == CapturePolicy::DROP)
+			{
+				m_stats.dropped++;
+				return false;
+			}
+
+			m_slotFreed.wait(lock, [this]() { return !m_free.empty(); });
+		}
+
+		slot = m_free.back();
+		m_free.pop_back();
+		frame = m_nextFrame++;
+	}
+
+	// the only work done on the caller's thread, and it's done without the lock
+	const size_t pixelCount = m_width * m_height;
+	Color* destination = m_slots.data() + slot * pixelCount;
+
+	if (invertY)
+	{
+		for (size_t y = 0; y < m_height; y++)
+		{
+			std::memcpy(destination + y * m_width, pixels + (m_height - 1 - y) * m_width, m_width * sizeof(Color));
+		}
+	}
+	else
+	{
+		std::memcpy(destination, pixels, pixelCount * sizeof(Color));
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_filled[(m_filledHead + m_filledCount) % m_filled.size()] = { slot, frame };
+		m_filledCount++;
+		m_stats.captured++;
+	}
+	m_slotFilled.notify_one();
+
+	return true;
+}
+
+CaptureStats FrameCapture::Stats() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	return m_stats;
+}
+
+void FrameCapture::EncoderLoop() noexcept
+{
+	static constexpr const char* EXTENSION[] = { "png", "qoi", "bgr" };
+
+	std::vector<uint8_t> scratch; // reused by every frame this thread encodes
+
+	std::unique_lock lock(m_mutex);
+
+	while (true)
+	{
+		// when stopping, whatever was captured is still written
+		m_slotFilled.wait(lock, [this]() { return m_stop || m_filledCount != 0; });
+
+		if (m_filledCount == 0) // only reachable when stopping
+		{
+			return;
+		}
+
+		const Job job = m_filled[m_filledHead];
+		m_filledHead = (m_filledHead + 1) % m_filled.size();
+		m_filledCount--;
+		lock.unlock();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%05zu.%s", job.frame, EXTENSION[std::to_underlying(m_options.format)]);
+
+		const std::filesystem::path path = m_options.outputDirectory / name;
+		const Color* pixels = m_slots.data() + job.slot * m_width * m_height;
+		const RESULT_VALUE result = WriteImage(path, pixels, m_width, m_height, scratch);
+
+		lock.lock();
+		m_free.push_back(job.slot);
+		result == RESULT_VALUE::OK ? m_stats.written++ : m_stats.failed++;
+		m_slotFreed.notify_one();
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include "Color.hpp"
+#include "ErrorEnum.hpp"
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat : uint8_t
+{
+	PNG, // smallest files, the slowest to encode by far
+	QOI, // lossless too, bigger files but about as fast to encode as the frames are drawn
+	RAW, // the pixels as they are, see WriteImage's .bgr
+};
+
+// what happens to a frame when every slot still holds one the encoders haven't gotten to
+enum class CapturePolicy : uint8_t
+{
+	DROP, // the frame isn't captured, rendering never waits
+	WAIT, // rendering waits for a slot, every frame is captured
+};
+
+struct CaptureOptions
+{
+	std::filesystem::path outputDirectory; // frames are written there as frame_00000.png, frame_00001.png... counting from the first captured one
+	CaptureFormat format = CaptureFormat::QOI;
+	CapturePolicy policy = CapturePolicy::DROP;
+	size_t slotCount = 8;       // frames copied but not encoded yet, all allocated up front
+	size_t encoderThreads = 2;  // 0 picks one per hardware thread
+};
+
+struct CaptureStats
+{
+	size_t captured = 0; // copied into a slot
+	size_t dropped = 0;  // found every slot busy, see CapturePolicy::DROP
+	size_t written = 0;  // encoded and written
+	size_t failed = 0;   // encoded but not written, the error is on the console
+};
+
+// Ring of preallocated frame slots with encoder threads behind it: Submit copies a frame into a free slot and returns,
+// the encoders write the slots to files in the background and hand them back. See Application::StartCapture
+class FrameCapture
+{
+public:
+	FrameCapture(size_t width, size_t height, CaptureOptions options);
+
+	~FrameCapture(); // Finish
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Copies width * height pixels, the first row at the top unless invertY, into a free slot: a single memcpy, or one per row
+	// when flipping it. False when the frame was dropped. Only for a single thread at a time
+	bool Submit(const Color* pixels, bool invertY) noexcept;
+
+	// Writes every frame already captured and stops the encoders, Submit mustn't be called anymore. Stats are final afterwards
+	void Finish() noexcept;
+
+	CaptureStats Stats() const noexcept;
+
+private:
+	struct Job
+	{
+		size_t slot = 0;
+		size_t frame = 0;
+	};
+
+	void EncoderLoop() noexcept;
+
+	size_t m_width;
+	size_t m_height;
+	CaptureOptions m_options;
+	std::vector<Color> m_slots; // m_options.slotCount frames back to back
+
+	// Slots are handed around by index, both lists have room for every slot so they never allocate.
+	// m_free is a stack, m_filled a ring in capture order starting at m_filledHead
+	std::vector<size_t> m_free;
+	std::vector<Job> m_filled;
+	size_t m_filledHead = 0;
+	size_t m_filledCount = 0;
+
+	size_t m_nextFrame = 0;
+	CaptureStats m_stats;
+	bool m_stop = false;
+
+	mutable std::mutex m_mutex; // of everything above but the pixels of the slots, which belong to whoever holds their index
+	std::condition_variable m_slotFilled;
+	std::condition_variable m_slotFreed;
+	std::vector<std::thread> m_encoders;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define CLIPPING_HPP
 
 #include "GeometricData.hpp"
+#include <cstring>
 
 // many thanks to OLC for making this resource freely available
 // https://github.com/OneLoneCoder/Javidx9/tree/master/ConsoleGameEngine/BiggerProjects/Engine3D
@@ -129,4 +130,108 @@ inline ClippedTriangle<vertexType> ClipAgainstPlane(const Vec3f& plane_p, const
 }
 
 
+// Vertex as the clip space clipper sees it, only what's still needed once the transform stage is done
+struct ClipVertex
+{
+	Vec4f position; // homogeneous clip space, not divided by w yet
+	Vec2f uv;
+};
+
+// Convex polygon left of a triangle after clipping, its vertices are indices into a small pool so a vertex
+// is only ever written when a plane creates it. Meant to be reused from triangle to triangle by the same thread
+struct ClipPolygon
+{
+	// every plane adds at most one vertex to the polygon, and creates two new ones when it cuts it
+	static constexpr size_t MAX_VERTICES = 3 + 6;
+	static constexpr size_t MAX_POOL = 3 + 6 * 2;
+
+	ClipVertex pool[MAX_POOL];
+	uint8_t indices[MAX_VERTICES];
+	uint32_t poolSize = 0;
+	uint32_t count = 0;
+};
+
+// signed distance to one of the frustum planes in clip space, positive inside, plane is a single OUTCODE bit.
+// The x and y planes are pushed out by guardX and guardY, same as in ComputeOutcode
+inline float ClipPlaneDistance(const Vec4f& p, uint8_t plane, float guardX = 1.0f, float guardY = 1.0f) noexcept
+{
+	switch (plane)
+	{
+		case OUTCODE_LEFT:   return guardX * p.w + p.x;
+		case OUTCODE_RIGHT:  return guardX * p.w - p.x;
+		case OUTCODE_BOTTOM: return guardY * p.w + p.y;
+		case OUTCODE_TOP:    return guardY * p.w - p.y;
+		case OUTCODE_NEAR:   return p.z;
+		default:             return p.w - p.z; // OUTCODE_FAR
+	}
+}
+
+// Winding of a triangle given in clip space, from the determinant of its (x, y, w) rows. It's the same sign as the projected area
+// whenever every w is positive, but stays correct for triangles crossing the camera plane, so it can run before clipping
+inline bool IsBackFacing(const Vec4f& a, const Vec4f& b, const Vec4f& c) noexcept
+{
+	const float det = a.x * (b.y * c.w - c.y * b.w) - b.x * (a.y * c.w - c.y * a.w) + c.x * (a.y * b.w - b.y * a.w);
+	return det >= 0.0f;
+}
+
+// Sutherland-Hodgman in homogeneous clip space, before the perspective divide.
+// The triangle must be in pool[0..2], planes is a mask of OUTCODE bits to clip against (the union of the vertex outcodes is enough).
+// Returns the vertex count of the clipped polygon in polygon.indices, 0 when nothing is left of it
+inline uint32_t ClipTriangle(ClipPolygon& polygon, uint8_t planes, float guardX = 1.0f, float guardY = 1.0f) noexcept
+{
+	polygon.indices[0] = 0;
+	polygon.indices[1] = 1;
+	polygon.indices[2] = 2;
+	polygon.poolSize = 3;
+	polygon.count = 3;
+
+	while (planes != 0)
+	{
+		const uint8_t plane = static_cast<uint8_t>(planes & -planes); // lowest set bit
+		planes = static_cast<uint8_t>(planes & (planes - 1));
+
+		uint8_t clipped[ClipPolygon::MAX_VERTICES];
+		uint32_t clippedCount = 0;
+
+		for (uint32_t i = 0; i < polygon.count; i++)
+		{
+			const uint8_t current = polygon.indices[i];
+			const uint8_t next = polygon.indices[(i + 1) % polygon.count];
+			const float dCurrent = ClipPlaneDistance(polygon.pool[current].position, plane, guardX, guardY);
+			const float dNext = ClipPlaneDistance(polygon.pool[next].position, plane, guardX, guardY);
+
+			if (dCurrent >= 0.0f)
+			{
+				clipped[clippedCount++] = current;
+			}
+
+			if ((dCurrent >= 0.0f) != (dNext >= 0.0f))
+			{
+				// always interpolate from the inside vertex, so an edge shared by two triangles gets the exact same new vertex
+				const bool currentInside = dCurrent >= 0.0f;
+				const ClipVertex& from = polygon.pool[currentInside ? current : next];
+				const ClipVertex& to = polygon.pool[currentInside ? next : current];
+				const float t = currentInside ? dCurrent / (dCurrent - dNext) : dNext / (dNext - dCurrent);
+
+				ClipVertex& created = polygon.pool[polygon.poolSize];
+				created.position = lerp(from.position, to.position, t);
+				created.uv = lerp(from.uv, to.uv, t);
+				clipped[clippedCount++] = static_cast<uint8_t>(polygon.poolSize++);
+			}
+		}
+
+		if (clippedCount < 3)
+		{
+			polygon.count = 0;
+			return 0;
+		}
+
+		memcpy(polygon.indices, clipped, clippedCount);
+		polygon.count = clippedCount;
+	}
+
+	return polygon.count;
+}
+
+
 #endif
\ No newline at end of file
@@ -1,7 +1,8 @@
 #ifndef COLLISIONS_HPP
 #define COLLISIONS_HPP
 
-#include "NaiveMath.hpp"
+#include "Transform.hpp"
+#include <cfloat>
 
 struct AABB
 {
@@ -9,4 +10,83 @@ struct AABB
 	Vec3f max;
 };
 
+inline AABB Merge(const AABB& a, const AABB& b) noexcept
+{
+	return
+	{
+		{ fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z) },
+		{ fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z) }
+	};
+}
+
+// Outcodes of the 8 corners of a box, combined. When "all" isn't 0 every corner is outside of the same frustum plane
+// and the box can't be seen, when "any" is 0 the box is completely inside of the frustum
+struct BoxOutcodes
+{
+	uint8_t all = 0;
+	uint8_t any = 0;
+};
+
+// clip space positions and outcodes of the 8 corners of a box
+struct BoxCorners
+{
+	float x[8];
+	float y[8];
+	float z[8];
+	float w[8];
+	uint8_t outcode[8];
+};
+
+// toClip takes the box from the space it's defined in to clip space, i.e. world * view * projection for a model space box
+inline BoxCorners TransformCorners(const AABB& box, const Matrix4x4f& toClip) noexcept
+{
+	const float x[8] = { box.min.x, box.max.x, box.min.x, box.max.x, box.min.x, box.max.x, box.min.x, box.max.x };
+	const float y[8] = { box.min.y, box.min.y, box.max.y, box.max.y, box.min.y, box.min.y, box.max.y, box.max.y };
+	const float z[8] = { box.min.z, box.min.z, box.min.z, box.min.z, box.max.z, box.max.z, box.max.z, box.max.z };
+
+	BoxCorners corners;
+	TransformPoints(toClip, x, y, z, 8, corners.x, corners.y, corners.z, corners.w, corners.outcode);
+
+	return corners;
+}
+
+inline BoxOutcodes ClassifyAABB(const AABB& box, const Matrix4x4f& toClip) noexcept
+{
+	const BoxCorners corners = TransformCorners(box, toClip);
+
+	BoxOutcodes out = { corners.outcode[0], corners.outcode[0] };
+	for (size_t i = 1; i < 8; i++)
+	{
+		out.all &= corners.outcode[i];
+		out.any |= corners.outcode[i];
+	}
+
+	return out;
+}
+
+// Size of the screen rect around a box in normalized device coordinates, 2 being the whole view port.
+// A box reaching behind the camera has no such rect and is as big as it gets
+inline Vec2f ProjectedExtent(const AABB& box, const Matrix4x4f& toClip) noexcept
+{
+	const BoxCorners corners = TransformCorners(box, toClip);
+
+	Vec2f min = { FLT_MAX, FLT_MAX };
+	Vec2f max = { -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < 8; i++)
+	{
+		if (corners.w[i] <= 0.0f)
+		{
+			return { FLT_MAX, FLT_MAX };
+		}
+
+		const float invW = 1.0f / corners.w[i];
+		min.x = fminf(min.x, corners.x[i] * invW);
+		min.y = fminf(min.y, corners.y[i] * invW);
+		max.x = fmaxf(max.x, corners.x[i] * invW);
+		max.y = fmaxf(max.y, corners.y[i] * invW);
+	}
+
+	return { max.x - min.x, max.y - min.y };
+}
+
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define COLOR_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <algorithm>
 
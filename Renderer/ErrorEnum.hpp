@@ -21,6 +21,7 @@ enum class RESULT_VALUE : uint8_t
 	ALLOCATED_OBJECTS_EXCEEDED,
 	MISSING_FILEPATH,
 	ASSIMP_FAILURE,
+	PLATFORM_UNAVAILABLE,
 };
 
 static constexpr const char* RV_MSG[] = 
@@ -37,6 +38,7 @@ static constexpr const char* RV_MSG[] =
 	"ALLOCATED_OBJECTS_EXCEEDED. Check Allocator::Init() 3rd parameter",
 	"MISSING_FILEPATH. Check if the path to a file really exists",
 	"ASSIMP_FAILURE. Failed to load data from ASSIMP, model wasn't loaded",
+	"PLATFORM_UNAVAILABLE. There's no window on this platform, use the headless Application::Start",
 };
 
 static constexpr const char* Error(RESULT_VALUE val) noexcept
@@ -3,7 +3,9 @@
 
 #include "Allocator.hpp"
 #include "NaiveMath.hpp"
+#include <algorithm>
 #include <filesystem>
+#include <immintrin.h>
 
 struct Vertex
 {
@@ -33,6 +35,122 @@ inline Vertex lerp(const Vertex& v1, const Vertex& v2, float t) noexcept
 	};
 }
 
+struct PackedPosition
+{
+	uint16_t x = 0;
+	uint16_t y = 0;
+	uint16_t z = 0;
+};
+
+// unit vector folded onto an octahedron and flattened to 2 signed 16 bit values
+struct PackedNormal
+{
+	int16_t x = 0;
+	int16_t y = 0;
+};
+
+// half floats, uvs past [0, 1] for wrapping textures still work
+struct PackedUV
+{
+	uint16_t u = 0;
+	uint16_t v = 0;
+
+	operator Vec2f() const noexcept
+	{
+		return { _cvtsh_ss(u), _cvtsh_ss(v) };
+	}
+};
+
+inline PackedNormal EncodeNormal(const Vec3f& n) noexcept
+{
+	const float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum == 0.0f)
+	{
+		return {};
+	}
+
+	float x = n.x / sum;
+	float y = n.y / sum;
+
+	// the lower half is folded over the diagonals onto the outer corners of the square
+	if (n.z < 0.0f)
+	{
+		const float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return
+	{
+		static_cast<int16_t>(lroundf(std::clamp(x, -1.0f, 1.0f) * 32767.0f)),
+		static_cast<int16_t>(lroundf(std::clamp(y, -1.0f, 1.0f) * 32767.0f))
+	};
+}
+
+inline Vec3f DecodeNormal(const PackedNormal& packed) noexcept
+{
+	float x = packed.x / 32767.0f;
+	float y = packed.y / 32767.0f;
+	const float z = 1.0f - fabsf(x) - fabsf(y);
+
+	const float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	return normalize(Vec3f{ x, y, z });
+}
+
+// Half the size of a Vertex, for meshes that don't need all of its precision. Positions are 16 bit steps across the box
+// of their mesh and only make sense along with it, see Mesh::positionScale. Pick Vertex instead for meshes that need the precision
+struct PackedVertex
+{
+	static constexpr bool quantized = true;
+
+	PackedPosition position;
+	PackedNormal normals;
+	PackedUV uv;
+	uint16_t padding = 0;
+
+	PackedVertex() = default;
+
+	// vert.position has to be in steps of the box already, see Mesh::Encode
+	PackedVertex(const Vertex& vert) noexcept :
+		position
+		{
+			static_cast<uint16_t>(std::clamp(vert.position.x + 0.5f, 0.0f, 65535.0f)),
+			static_cast<uint16_t>(std::clamp(vert.position.y + 0.5f, 0.0f, 65535.0f)),
+			static_cast<uint16_t>(std::clamp(vert.position.z + 0.5f, 0.0f, 65535.0f))
+		},
+		normals(EncodeNormal(vert.normals)),
+		uv{ _cvtss_sh(vert.uv.x, _MM_FROUND_TO_NEAREST_INT), _cvtss_sh(vert.uv.y, _MM_FROUND_TO_NEAREST_INT) }
+	{
+	}
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex is meant to be half of a Vertex");
+
+// position still in steps of the box
+inline Vertex Unpack(const PackedVertex& v) noexcept
+{
+	const Vec3f steps = { static_cast<float>(v.position.x), static_cast<float>(v.position.y), static_cast<float>(v.position.z) };
+	return { steps, DecodeNormal(v.normals), v.uv };
+}
+
+inline Vertex Unpack(const Vertex& v) noexcept
+{
+	return v;
+}
+
+inline Vertex lerp(const PackedVertex& v1, const PackedVertex& v2, float t) noexcept
+{
+	return lerp(Unpack(v1), Unpack(v2), t);
+}
+
+// vertex types storing positions relative to the box of their mesh
+template <typename vertexType>
+concept quantizedVertex = requires { requires vertexType::quantized; };
+
 template <typename vertexType>
 concept minVertex = requires(const Vertex& vert, const vertexType& v1, const vertexType & v2, float t)
 {
@@ -69,11 +187,177 @@ struct Triangle
 	}
 };
 
+// Small cluster of neighbouring triangles, culled as a whole before any of its triangles is looked at, see GenerateMeshlets
+struct Meshlet
+{
+	uint32_t firstIndex = 0; // the triangles of a meshlet are contiguous in Mesh::indices
+	uint32_t indexCount = 0;
+
+	// bounding sphere
+	Vec3f center;
+	float radius = 0.0f;
+
+	// Every triangle faces away from a point looking along coneAxis at coneApex from inside of the cone with coneCutoff as the cosine
+	// of its half angle, i.e. dot(normalize(coneApex - eye), coneAxis) >= coneCutoff. Triangles facing too many ways get a cutoff over 1
+	Vec3f coneApex;
+	Vec3f coneAxis;
+	float coneCutoff = 2.0f;
+};
+
+// Vertex data as one array per component (structure of arrays), which the batch transform reads as it is.
+// Positions are kept in the units of the vertex type they came from, so quantized ones still go through Mesh::Dequantization
+struct VertexStreams
+{
+	A::array<float> x;
+	A::array<float> y;
+	A::array<float> z;
+	A::array<float> nx;
+	A::array<float> ny;
+	A::array<float> nz;
+	A::array<float> u;
+	A::array<float> v;
+
+	size_t Size() const noexcept { return x.size(); }
+};
+
 template <minVertex vertexType = Vertex>
 struct Mesh
 {
 	A::array<vertexType> vertices;
 	A::array<uint32_t> indices;
+	A::array<uint16_t> indices16; // replaces indices when every vertex fits in 16 bits, see CompactIndices
+	A::array<Meshlet> meshlets; // cover all of indices when there are any
+	VertexStreams streams; // replaces vertices once the mesh is converted, see ConvertToStreams
+
+	// a quantized position p is at positionOffset + p * positionScale in model space, the box of the mesh split in 65535 steps
+	Vec3f positionScale = { 1.0f, 1.0f, 1.0f };
+	Vec3f positionOffset;
+
+	size_t VertexCount() const noexcept { return streams.Size() > 0 ? streams.Size() : vertices.size(); }
+	size_t IndexCount() const noexcept { return indices16.size() > 0 ? indices16.size() : indices.size(); }
+
+	// Calls fn with a pointer to the indices of whichever width the mesh has, so code templated on it
+	// picks the width once instead of on every index
+	template <typename Fn>
+	decltype(auto) VisitIndices(Fn&& fn) const
+	{
+		if (indices16.size() > 0)
+		{
+			return fn(static_cast<const uint16_t*>(&indices16[0]));
+		}
+		return fn(indices.size() > 0 ? static_cast<const uint32_t*>(&indices[0]) : nullptr);
+	}
+
+	// spans the grid of a quantized mesh over the box, before any vertex goes in
+	void SetQuantizationBox(const Vec3f& min, const Vec3f& max) noexcept
+	{
+		const Vec3f extent = max - min;
+		positionOffset = min;
+		positionScale =
+		{
+			extent.x > 0.0f ? extent.x / 65535.0f : 1.0f,
+			extent.y > 0.0f ? extent.y / 65535.0f : 1.0f,
+			extent.z > 0.0f ? extent.z / 65535.0f : 1.0f
+		};
+	}
+
+	// the vertex type for a model space vertex
+	vertexType Encode(const Vertex& vert) const noexcept
+	{
+		if constexpr (quantizedVertex<vertexType>)
+		{
+			Vertex steps = vert;
+			steps.position = vert.position - positionOffset;
+			steps.position.x /= positionScale.x;
+			steps.position.y /= positionScale.y;
+			steps.position.z /= positionScale.z;
+			return vertexType(steps);
+		}
+		else
+		{
+			return vertexType(vert);
+		}
+	}
+
+	Vec3f ModelPosition(size_t index) const noexcept
+	{
+		const auto& p = vertices[index].position;
+		return positionOffset + Vec3f{ static_cast<float>(p.x), static_cast<float>(p.y), static_cast<float>(p.z) } * positionScale;
+	}
+
+	// takes the positions as they're stored to model space, identity for float positions
+	Matrix4x4f Dequantization() const noexcept
+	{
+		return
+		{
+			positionScale.x, 0, 0, 0,
+			0, positionScale.y, 0, 0,
+			0, 0, positionScale.z, 0,
+			positionOffset.x, positionOffset.y, positionOffset.z, 1.0f
+		};
+	}
+	A::array<Mesh<vertexType>> lods; // simplified versions, coarser with every entry. Empty for a mesh without any
 };
 
+// Moves the vertices of a mesh to streams and frees the interleaved ones, memory comes from the Allocator.
+// Anything reading vertices (LODs, meshlets) has to run before. Leaves the mesh as it was when out of memory
+template <minVertex vertexType>
+void ConvertToStreams(Mesh<vertexType>& mesh) noexcept
+{
+	const size_t count = mesh.vertices.size();
+	VertexStreams& streams = mesh.streams;
+
+	if (count == 0 || streams.Size() > 0)
+	{
+		return;
+	}
+
+	A::array<float>* arrays[] = { &streams.x, &streams.y, &streams.z, &streams.nx, &streams.ny, &streams.nz, &streams.u, &streams.v };
+	for (A::array<float>* stream : arrays)
+	{
+		if (!stream->make_array(*stream, count))
+		{
+			for (A::array<float>* allocated : arrays)
+			{
+				allocated->destroy();
+			}
+			return;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex vert = Unpack(mesh.vertices[i]);
+
+		streams.x.emplace_back(vert.position.x);
+		streams.y.emplace_back(vert.position.y);
+		streams.z.emplace_back(vert.position.z);
+		streams.nx.emplace_back(vert.normals.x);
+		streams.ny.emplace_back(vert.normals.y);
+		streams.nz.emplace_back(vert.normals.z);
+		streams.u.emplace_back(vert.uv.x);
+		streams.v.emplace_back(vert.uv.y);
+	}
+
+	mesh.vertices.destroy();
+}
+
+// Moves the indices of a mesh with few enough vertices to 16 bits, halving them. Like ConvertToStreams it comes after anything
+// reading Mesh::indices, and leaves the mesh as it was when it's out of memory or has too many vertices
+template <minVertex vertexType>
+void CompactIndices(Mesh<vertexType>& mesh) noexcept
+{
+	if (mesh.indices.size() == 0 || mesh.VertexCount() > 65536 || !mesh.indices16.make_array(mesh.indices16, mesh.indices.size()))
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		mesh.indices16.emplace_back(static_cast<uint16_t>(mesh.indices[i]));
+	}
+
+	mesh.indices.destroy();
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "Headless.hpp"
+#include "Images.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace Platform
+{
+	bool Headless::ProcessEvents() noexcept
+	{
+		return m_framesStarted++ < m_options.frameCount;
+	}
+
+	float Headless::FrameTime() noexcept
+	{
+		return m_options.framesPerSecond > 0.0f ? 1.0f / m_options.framesPerSecond : 0.0f;
+	}
+
+	void Headless::Present(const Color* pixels, size_t width, size_t height, bool invertY) noexcept
+	{
+		const size_t frame = m_framesPresented++;
+
+		if (invertY)
+		{
+			m_flipped.resize(width * height);
+			for (size_t y = 0; y < height; y++)
+			{
+				std::copy(pixels + (height - 1 - y) * width, pixels + (height - y) * width, m_flipped.begin() + y * width);
+			}
+			pixels = m_flipped.data();
+		}
+
+		if (m_options.onFrame)
+		{
+			m_options.onFrame(frame, pixels, width, height);
+		}
+		else if (!m_options.outputDirectory.empty())
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "frame_%05zu.png", frame);
+
+			logResult(WriteImage(m_options.outputDirectory / name, pixels, width, height));
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#include "Platform.hpp"
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+namespace Platform
+{
+	// what a headless Application renders and where the frames go, see Application::Start
+	struct HeadlessOptions
+	{
+		size_t frameCount = 1;          // OnUpdate runs this many times, then Start returns
+		float framesPerSecond = 60.0f;  // every OnUpdate gets a dt of exactly 1 / framesPerSecond, however long the frame took
+
+		// Gets every finished frame, width * height pixels with the first row at the top whatever Application::InvertYaxis says.
+		// Called from the raster stage, see Backend::Present. The pixels only stay valid during the call
+		std::function<void(size_t frame, const Color* pixels, size_t width, size_t height)> onFrame;
+
+		// Without onFrame the frames are written there as frame_00000.png, frame_00001.png... (see WriteImage), when it isn't empty
+		std::filesystem::path outputDirectory;
+	};
+
+	// No window, no input and a synthetic clock, for rendering on machines without a display
+	class Headless final : public Backend
+	{
+	public:
+		explicit Headless(HeadlessOptions options) noexcept : m_options(std::move(options)) {}
+
+		bool ProcessEvents() noexcept override;
+		float FrameTime() noexcept override;
+		void Present(const Color* pixels, size_t width, size_t height, bool invertY) noexcept override;
+
+	private:
+		HeadlessOptions m_options;
+		size_t m_framesStarted = 0;
+		size_t m_framesPresented = 0;
+		std::vector<Color> m_flipped; // rows of an inverted frame put back in order
+	};
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "Images.hpp"
+#include <cstring>
+#include <fstream>
 #include <utility>
+#include <vector>
 
 #pragma warning(push)
 #pragma warning(disable: 4244)
@@ -8,6 +11,9 @@
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #endif
+#ifndef STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#endif
 #include <stb_image.h>
 #include <stb_image_write.h>
 #pragma warning(pop)
@@ -29,7 +35,9 @@ RESULT_VALUE Image::LoadFromFile(std::filesystem::path path)
 	if (_stbi_image)
 	{
 		const size_t imgSize = (size_t)width * height * sizeof(Color);
-		const RESULT_VALUE val = Allocator::Allocate(reinterpret_cast<void*&>(pixelGrid), imgSize);
+
+		// the rasterizer fetches texels as 4 bytes, the padding keeps the last one inside the allocation
+		const RESULT_VALUE val = Allocator::Allocate(reinterpret_cast<void*&>(pixelGrid), imgSize + sizeof(uint32_t) - sizeof(Color));
 
 		if (val == RESULT_VALUE::OK)
 		{
@@ -79,3 +87,187 @@ Color Image::sample(float u, float v) const noexcept
 
 	return pixelGrid[y * width + x];
 }
+
+// whole file at once, for the formats stb doesn't write
+static RESULT_VALUE WriteBytes(const std::filesystem::path& path, const void* bytes, size_t size)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+	file.close();
+
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path.string() << std::endl;
+		return RESULT_VALUE::GENERIC_ERROR;
+	}
+
+	return RESULT_VALUE::OK;
+}
+
+RESULT_VALUE WriteImage(const std::filesystem::path& path, const Color* pixels, size_t width, size_t height)
+{
+	std::vector<uint8_t> scratch;
+	return WriteImage(path, pixels, width, height, scratch);
+}
+
+RESULT_VALUE WriteImage(const std::filesystem::path& path, const Color* pixels, size_t width, size_t height, std::vector<uint8_t>& scratch)
+{
+	const std::string file = path.string();
+	const std::filesystem::path extension = path.extension();
+
+	if (extension == ".qoi")
+	{
+		EncodeQOI(pixels, width, height, scratch);
+		return WriteBytes(path, scratch.data(), scratch.size());
+	}
+	else if (extension == ".bgr")
+	{
+		return WriteBytes(path, pixels, width * height * sizeof(Color));
+	}
+
+	// back to RGB, the way every format stb writes expects it
+	scratch.resize(width * height * sizeof(Color));
+	uint8_t* rgb = scratch.data();
+	for (size_t i = 0; i < width * height; i++)
+	{
+		rgb[i * sizeof(Color) + 0] = pixels[i].red;
+		rgb[i * sizeof(Color) + 1] = pixels[i].green;
+		rgb[i * sizeof(Color) + 2] = pixels[i].blue;
+	}
+
+	const int w = static_cast<int>(width);
+	const int h = static_cast<int>(height);
+	int written = 0;
+
+	if (extension == ".png")
+	{
+		written = stbi_write_png(file.c_str(), w, h, sizeof(Color), rgb, w * static_cast<int>(sizeof(Color)));
+	}
+	else if (extension == ".bmp")
+	{
+		written = stbi_write_bmp(file.c_str(), w, h, sizeof(Color), rgb);
+	}
+	else if (extension == ".tga")
+	{
+		written = stbi_write_tga(file.c_str(), w, h, sizeof(Color), rgb);
+	}
+	else if (extension == ".jpg" || extension == ".jpeg")
+	{
+		written = stbi_write_jpg(file.c_str(), w, h, sizeof(Color), rgb, 90);
+	}
+	else
+	{
+		std::cerr << "Can't write " << file << ", the extension has to be .png, .bmp, .tga, .jpg, .qoi or .bgr\n";
+		return RESULT_VALUE::GENERIC_ERROR;
+	}
+
+	if (written == 0)
+	{
+		std::cerr << "Failed to write " << file << std::endl;
+		return RESULT_VALUE::STB_ERROR;
+	}
+
+	return RESULT_VALUE::OK;
+}
+
+void EncodeQOI(const Color* pixels, size_t width, size_t height, std::vector<uint8_t>& out)
+{
+	constexpr uint8_t OP_INDEX = 0x00;
+	constexpr uint8_t OP_DIFF = 0x40;
+	constexpr uint8_t OP_LUMA = 0x80;
+	constexpr uint8_t OP_RUN = 0xc0;
+	constexpr uint8_t OP_RGB = 0xfe;
+
+	// header, the worst case of 4 bytes per pixel and the end marker
+	out.resize(14 + width * height * 4 + 8);
+	uint8_t* write = out.data();
+
+	const auto u32 = [&write](uint32_t value)
+		{
+			*write++ = static_cast<uint8_t>(value >> 24);
+			*write++ = static_cast<uint8_t>(value >> 16);
+			*write++ = static_cast<uint8_t>(value >> 8);
+			*write++ = static_cast<uint8_t>(value);
+		};
+
+	*write++ = 'q'; *write++ = 'o'; *write++ = 'i'; *write++ = 'f';
+	u32(static_cast<uint32_t>(width));
+	u32(static_cast<uint32_t>(height));
+	*write++ = 3; // RGB, alpha is always 255
+	*write++ = 0; // sRGB
+
+	// previously seen colors, by hash. Alpha never changes so it's left out of the comparisons, but not out of the hash
+	Color seen[64] = {};
+	bool seenValid[64] = {};
+	Color previous;
+	size_t run = 0;
+
+	const size_t count = width * height;
+	for (size_t i = 0; i < count; i++)
+	{
+		const Color pixel = pixels[i];
+
+		if (pixel.red == previous.red && pixel.green == previous.green && pixel.blue == previous.blue)
+		{
+			run++;
+			if (run == 62 || i + 1 == count)
+			{
+				*write++ = static_cast<uint8_t>(OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			*write++ = static_cast<uint8_t>(OP_RUN | (run - 1));
+			run = 0;
+		}
+
+		const size_t hash = (pixel.red * 3 + pixel.green * 5 + pixel.blue * 7 + 255 * 11) % 64;
+		const Color& cached = seen[hash];
+
+		if (seenValid[hash] && cached.red == pixel.red && cached.green == pixel.green && cached.blue == pixel.blue)
+		{
+			*write++ = static_cast<uint8_t>(OP_INDEX | hash);
+		}
+		else
+		{
+			seen[hash] = pixel;
+			seenValid[hash] = true;
+
+			const int8_t dr = static_cast<int8_t>(pixel.red - previous.red);
+			const int8_t dg = static_cast<int8_t>(pixel.green - previous.green);
+			const int8_t db = static_cast<int8_t>(pixel.blue - previous.blue);
+			const int8_t drg = static_cast<int8_t>(dr - dg);
+			const int8_t dbg = static_cast<int8_t>(db - dg);
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				*write++ = static_cast<uint8_t>(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+			}
+			else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+			{
+				*write++ = static_cast<uint8_t>(OP_LUMA | (dg + 32));
+				*write++ = static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8));
+			}
+			else
+			{
+				*write++ = OP_RGB;
+				*write++ = pixel.red;
+				*write++ = pixel.green;
+				*write++ = pixel.blue;
+			}
+		}
+
+		previous = pixel;
+	}
+
+	for (size_t i = 0; i < 7; i++)
+	{
+		*write++ = 0;
+	}
+	*write++ = 1;
+
+	out.resize(write - out.data());
+}
@@ -5,6 +5,7 @@
 #include "NaiveMath.hpp"
 #include "Color.hpp"
 #include <filesystem>
+#include <vector>
 
 struct Image
 {
@@ -24,4 +25,17 @@ public:
 	int32_t channels = 0;
 };
 
+// Writes width * height pixels, ordered like the back buffers (BGR, first row at the top), as an image file.
+// The format comes from the extension: .png, .bmp, .tga or .jpg through stb_image_write, .qoi (see EncodeQOI) or .bgr, the pixels as they are
+// without any header, which is the fastest to write and what e.g. ffmpeg reads as rawvideo bgr24
+[[nodiscard]] RESULT_VALUE WriteImage(const std::filesystem::path& path, const Color* pixels, size_t width, size_t height);
+
+// The same, encoding into scratch instead of a buffer of its own. scratch only grows, so writing many images through the same one
+// avoids allocating once it's big enough
+[[nodiscard]] RESULT_VALUE WriteImage(const std::filesystem::path& path, const Color* pixels, size_t width, size_t height, std::vector<uint8_t>& scratch);
+
+// The same pixels as a QOI image (https://qoiformat.org), lossless like PNG but an order of magnitude faster to encode.
+// out is overwritten and only grows, so reusing it avoids allocating once it's big enough
+void EncodeQOI(const Color* pixels, size_t width, size_t height, std::vector<uint8_t>& out);
+
 #endif
\ No newline at end of file
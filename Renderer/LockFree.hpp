@@ -0,0 +1,103 @@
+#ifndef LOCK_FREE_HPP
+#define LOCK_FREE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // the alignas(64) members pad the classes, on purpose
+
+// Bounded ring buffer for exactly one producer thread and one consumer thread, neither of them ever blocks or takes a lock.
+// Capacity must be a power of two, one slot is always left empty to tell a full queue from an empty one
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+public:
+	// producer only, false when the queue is full and the item was dropped
+	bool TryPush(const T& item) noexcept
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		const size_t next = (head + 1) & (Capacity - 1);
+
+		if (next == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		m_items[head] = item;
+		m_head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only, false when there's nothing to pop
+	bool TryPop(T& item) noexcept
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (tail == m_head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = m_items[tail];
+		m_tail.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	T m_items[Capacity] = {};
+
+	// on their own cache lines, each one is only ever written by one of the threads
+	alignas(64) std::atomic<size_t> m_head = 0; // next slot to write
+	alignas(64) std::atomic<size_t> m_tail = 0; // next slot to read
+};
+
+// Latest value handoff between one writer and one reader: the writer fills its own copy and publishes it, the reader takes the most
+// recently published one. Three copies means neither side ever waits for the other, the reader simply skips values it was too slow for
+template <typename T>
+class TripleBuffer
+{
+public:
+	// writer only, the copy to fill before Publish. It holds some older value, so it has to be filled completely
+	T& Back() noexcept { return m_values[m_back]; }
+
+	// writer only, hands Back() over to the reader and gets a new one
+	void Publish() noexcept
+	{
+		m_back = m_middle.exchange(static_cast<uint8_t>(m_back | FRESH), std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Reader only, the most recently published value. It's left untouched by the writer until the next call.
+	// Before anything is published it's a default constructed T
+	const T& Latest() noexcept
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & FRESH) != 0)
+		{
+			m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+		}
+
+		return m_values[m_front];
+	}
+
+	// reader only, whether Latest would return a newer value than last time
+	bool HasFresh() const noexcept
+	{
+		return (m_middle.load(std::memory_order_acquire) & FRESH) != 0;
+	}
+
+private:
+	static constexpr uint8_t INDEX = 0x3;
+	static constexpr uint8_t FRESH = 0x4; // set by the writer, cleared by the reader taking it
+
+	T m_values[3] = {};
+	uint8_t m_back = 0;  // owned by the writer
+	uint8_t m_front = 1; // owned by the reader
+	alignas(64) std::atomic<uint8_t> m_middle = 2;
+};
+
+#pragma warning(pop)
+
+#endif
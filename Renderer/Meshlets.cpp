@@ -0,0 +1,140 @@
+#include "Meshlets.hpp"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	// bounding sphere and normal cone of the triangles in [first, first + count)
+	void ComputeBounds(Meshlet& meshlet, const Vec3f* positions, const uint32_t* indices) noexcept
+	{
+		const uint32_t* triangles = indices + meshlet.firstIndex;
+
+		Vec3f min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		Vec3f max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = 0; i < meshlet.indexCount; i++)
+		{
+			const Vec3f& p = positions[triangles[i]];
+			min = { std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z) };
+			max = { std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z) };
+		}
+
+		meshlet.center = (min + max) * 0.5f;
+		float radius2 = 0.0f;
+		for (uint32_t i = 0; i < meshlet.indexCount; i++)
+		{
+			const Vec3f d = positions[triangles[i]] - meshlet.center;
+			radius2 = std::max(radius2, dot(d, d));
+		}
+		meshlet.radius = std::sqrt(radius2);
+
+		// Facing is decided the same way IsBackFacing does it, which makes cross(b - a, c - a) point to the front.
+		// Degenerate triangles have no side and don't take part
+		Vec3f normals[MESHLET_MAX_TRIANGLES];
+		Vec3f centers[MESHLET_MAX_TRIANGLES];
+		size_t count = 0;
+		Vec3f axis;
+
+		for (uint32_t i = 0; i < meshlet.indexCount; i += 3)
+		{
+			const Vec3f& a = positions[triangles[i]];
+			const Vec3f& b = positions[triangles[i + 1]];
+			const Vec3f& c = positions[triangles[i + 2]];
+
+			const Vec3f n = cross(b - a, c - a);
+			const float length = std::sqrt(dot(n, n));
+
+			if (length == 0.0f)
+			{
+				continue;
+			}
+
+			normals[count] = n * (1.0f / length);
+			centers[count] = (a + b + c) * (1.0f / 3.0f);
+			axis += normals[count];
+			count++;
+		}
+
+		const float axisLength = std::sqrt(dot(axis, axis));
+		if (count == 0 || axisLength == 0.0f)
+		{
+			return;
+		}
+		axis = axis * (1.0f / axisLength);
+
+		float minDot = 1.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			minDot = std::min(minDot, dot(normals[i], axis));
+		}
+
+		// normals spread over (almost) a half sphere, some triangle faces the eye from wherever it looks
+		if (minDot <= 0.1f)
+		{
+			return;
+		}
+
+		// the apex is pushed back along the axis until it's behind the plane of every triangle
+		float maxT = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			const float t = dot(centers[i] - meshlet.center, normals[i]) / dot(axis, normals[i]);
+			maxT = std::max(maxT, t);
+		}
+
+		meshlet.coneApex = meshlet.center - axis * maxT;
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> BuildMeshlets(const Vec3f* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+{
+	std::vector<Meshlet> meshlets;
+
+	// which meshlet last used a vertex, so the vertices of the current one are counted without clearing anything
+	std::vector<uint32_t> lastMeshlet(vertexCount, UINT32_MAX);
+
+	Meshlet current;
+	uint32_t currentId = 0;
+	size_t vertices = 0;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		size_t added = 0;
+		for (size_t v = 0; v < 3; v++)
+		{
+			added += lastMeshlet[indices[i + v]] != currentId;
+		}
+
+		// the corners may repeat a vertex, counting it twice only ever closes a meshlet a little early
+		if (vertices + added > MESHLET_MAX_VERTICES || current.indexCount == MESHLET_MAX_TRIANGLES * 3)
+		{
+			ComputeBounds(current, positions, indices);
+			meshlets.push_back(current);
+
+			current = Meshlet{};
+			current.firstIndex = static_cast<uint32_t>(i);
+			currentId++;
+			vertices = 0;
+		}
+
+		for (size_t v = 0; v < 3; v++)
+		{
+			if (lastMeshlet[indices[i + v]] != currentId)
+			{
+				lastMeshlet[indices[i + v]] = currentId;
+				vertices++;
+			}
+		}
+
+		current.indexCount += 3;
+	}
+
+	if (current.indexCount > 0)
+	{
+		ComputeBounds(current, positions, indices);
+		meshlets.push_back(current);
+	}
+
+	return meshlets;
+}
@@ -0,0 +1,158 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include "GeometricData.hpp"
+#include <array>
+#include <cmath>
+#include <vector>
+
+// limits of a single meshlet, small enough for its vertices to stay in cache while its triangles are processed
+static constexpr size_t MESHLET_MAX_VERTICES = 64;
+static constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Splits the triangles, in the order they come in, into runs using at most MESHLET_MAX_VERTICES different vertices and
+// MESHLET_MAX_TRIANGLES triangles, and computes the bounds and normal cone of every run. The loader leaves triangles
+// in a cache friendly order, so neighbouring triangles already end up in the same meshlet
+std::vector<Meshlet> BuildMeshlets(const Vec3f* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+
+// fills mesh.meshlets, memory comes from the Allocator and a mesh simply has no meshlets without any
+template <minVertex vertexType>
+void GenerateMeshlets(Mesh<vertexType>& mesh) noexcept
+{
+	if (mesh.indices.size() == 0)
+	{
+		return;
+	}
+
+	std::vector<Vec3f> positions(mesh.vertices.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		positions[i] = mesh.ModelPosition(i);
+	}
+
+	const std::vector<Meshlet> meshlets = BuildMeshlets(positions.data(), positions.size(), &mesh.indices[0], mesh.indices.size());
+
+	if (!mesh.meshlets.make_array(mesh.meshlets, meshlets.size()))
+	{
+		return;
+	}
+
+	for (const Meshlet& meshlet : meshlets)
+	{
+		mesh.meshlets.emplace_back(meshlet);
+	}
+}
+
+// The frustum planes and the eye in the space of a mesh, taken straight from the matrix bringing it to clip space,
+// so meshlets are tested where they are without transforming anything
+struct MeshletFrustum
+{
+	float planes[6][4]; // ax + by + cz + d >= 0 inside, unit normals
+	Vec3f eye;
+	bool hasEye = false; // false for a projection without one, no cone culling then
+};
+
+inline MeshletFrustum MakeMeshletFrustum(const Matrix4x4f& toClip) noexcept
+{
+	MeshletFrustum frustum;
+
+	// clip space component c of a point is x * rc[0][c] + y * rc[1][c] + z * rc[2][c] + rc[3][c], every plane is a sum of those columns
+	const auto column = [&toClip](int c, float sign, int base) noexcept
+		{
+			return std::array<float, 4>
+			{
+				toClip.rc[0][base] + sign * toClip.rc[0][c],
+				toClip.rc[1][base] + sign * toClip.rc[1][c],
+				toClip.rc[2][base] + sign * toClip.rc[2][c],
+				toClip.rc[3][base] + sign * toClip.rc[3][c]
+			};
+		};
+
+	const std::array<float, 4> planes[6] =
+	{
+		column(0, 1.0f, 3),  // w + x >= 0
+		column(0, -1.0f, 3), // w - x >= 0
+		column(1, 1.0f, 3),  // w + y >= 0
+		column(1, -1.0f, 3), // w - y >= 0
+		{ toClip.rc[0][2], toClip.rc[1][2], toClip.rc[2][2], toClip.rc[3][2] }, // z >= 0
+		column(2, -1.0f, 3)  // w - z >= 0
+	};
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		const float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+		const float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			frustum.planes[i][j] = planes[i][j] * invLength;
+		}
+	}
+
+	// the eye is the one point with clip space x, y and w all 0
+	const float a[3][3] =
+	{
+		{ toClip.rc[0][0], toClip.rc[1][0], toClip.rc[2][0] },
+		{ toClip.rc[0][1], toClip.rc[1][1], toClip.rc[2][1] },
+		{ toClip.rc[0][3], toClip.rc[1][3], toClip.rc[2][3] }
+	};
+	const float b[3] = { -toClip.rc[3][0], -toClip.rc[3][1], -toClip.rc[3][3] };
+
+	const auto det3 = [](const float m[3][3]) noexcept
+		{
+			return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+				 - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+				 + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		};
+
+	const float det = det3(a);
+	if (std::fabs(det) > 1e-12f)
+	{
+		float solution[3];
+		for (size_t c = 0; c < 3; c++)
+		{
+			float m[3][3];
+			for (size_t r = 0; r < 3; r++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					m[r][k] = k == c ? b[r] : a[r][k];
+				}
+			}
+			solution[c] = det3(m) / det;
+		}
+
+		frustum.eye = { solution[0], solution[1], solution[2] };
+		frustum.hasEye = true;
+	}
+
+	return frustum;
+}
+
+// false when the whole meshlet is outside of the frustum or faces away from the eye
+inline bool IsMeshletVisible(const Meshlet& meshlet, const MeshletFrustum& frustum) noexcept
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		const float* plane = frustum.planes[i];
+		if (plane[0] * meshlet.center.x + plane[1] * meshlet.center.y + plane[2] * meshlet.center.z + plane[3] < -meshlet.radius)
+		{
+			return false;
+		}
+	}
+
+	if (frustum.hasEye)
+	{
+		const Vec3f view = meshlet.coneApex - frustum.eye;
+		const float length = std::sqrt(dot(view, view));
+
+		if (dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * length)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#endif
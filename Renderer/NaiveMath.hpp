@@ -5,6 +5,7 @@
 #pragma warning(disable: 4201)
 
 #include <math.h>
+#include <cstring>
 #include <iostream>
 #include <immintrin.h>
 #include "SinCosTable.hpp"
@@ -296,6 +297,10 @@ inline Vec3f lerp(const Vec3f& v1, const Vec3f& v2, float t) noexcept
 {
 	return v1 + t * (v2 - v1);
 }
+inline Vec4f lerp(const Vec4f& v1, const Vec4f& v2, float t) noexcept
+{
+	return { v1.x + t * (v2.x - v1.x), v1.y + t * (v2.y - v1.y), v1.z + t * (v2.z - v1.z), v1.w + t * (v2.w - v1.w) };
+}
 inline Vec3f normalize(const Vec3f& v) noexcept
 {
 	return v / v.length();
@@ -395,6 +400,19 @@ struct Matrix4x4f
 		return out;
 	}
 
+	// same as operator*(const Vec3f&) but keeps w instead of dividing by it, i.e. the clip space position
+	Vec4f Homogeneous(const Vec3f& in) const noexcept
+	{
+		Vec4f out;
+
+		out.x = in.x * rc[0][0] + in.y * rc[1][0] + in.z * rc[2][0] + rc[3][0];
+		out.y = in.x * rc[0][1] + in.y * rc[1][1] + in.z * rc[2][1] + rc[3][1];
+		out.z = in.x * rc[0][2] + in.y * rc[1][2] + in.z * rc[2][2] + rc[3][2];
+		out.w = in.x * rc[0][3] + in.y * rc[1][3] + in.z * rc[2][3] + rc[3][3];
+
+		return out;
+	}
+
 	constexpr float at(int row, int column) const noexcept
 	{
 		return rc[row][column];
@@ -573,6 +591,35 @@ struct Matrix4x4f
 
 };
 
+// A bit is set for every frustum plane a clip space position is outside of, the visible volume being
+// -w <= x <= w, -w <= y <= w and 0 <= z <= w (see ProjectionMatrix)
+enum OUTCODE : uint8_t
+{
+	OUTCODE_LEFT   = 1 << 0,
+	OUTCODE_RIGHT  = 1 << 1,
+	OUTCODE_BOTTOM = 1 << 2,
+	OUTCODE_TOP    = 1 << 3,
+	OUTCODE_NEAR   = 1 << 4,
+	OUTCODE_FAR    = 1 << 5,
+
+	OUTCODE_SIDES  = OUTCODE_LEFT | OUTCODE_RIGHT | OUTCODE_BOTTOM | OUTCODE_TOP,
+};
+
+// guardX and guardY widen the x and y planes to -guard * w <= x <= guard * w, for guard band clipping
+inline uint8_t ComputeOutcode(const Vec4f& clip, float guardX = 1.0f, float guardY = 1.0f) noexcept
+{
+	uint8_t code = 0;
+
+	code |= (clip.x < -guardX * clip.w) ? OUTCODE_LEFT : 0;
+	code |= (clip.x > guardX * clip.w) ? OUTCODE_RIGHT : 0;
+	code |= (clip.y < -guardY * clip.w) ? OUTCODE_BOTTOM : 0;
+	code |= (clip.y > guardY * clip.w) ? OUTCODE_TOP : 0;
+	code |= (clip.z < 0.0f) ? OUTCODE_NEAR : 0;
+	code |= (clip.z > clip.w) ? OUTCODE_FAR : 0;
+
+	return code;
+}
+
 inline Matrix4x4f ProjectionMatrix(uint16_t screenWidth = 800, uint16_t screenHeight = 600, float FOV = 90.0f, float Near = 0.1f, float Far = 1000.0f) noexcept
 {
 	const float aspectRatio = (float)screenHeight / (float)screenWidth;
@@ -4,6 +4,9 @@
 #include "GeometricData.hpp"
 #include "Collisions.hpp"
 #include "Images.hpp"
+#include "Simplify.hpp"
+#include "Meshlets.hpp"
+#include "Reorder.hpp"
 
 #pragma warning(push)
 #pragma warning(disable: 4244)		// VS complains at the Assimp lib
@@ -14,6 +17,21 @@
 
 std::filesystem::path ResolvePath(const std::filesystem::path& path, const std::filesystem::path& parent) noexcept;
 
+enum class MeshLayout
+{
+	INTERLEAVED, // Mesh::vertices, one vertexType after the other
+	STREAMS      // Mesh::streams, the transform reads the positions straight from the mesh, see ConvertToStreams
+};
+
+// what LoadFromFile builds on top of the meshes in the file
+struct LoadOptions
+{
+	size_t lodLevels = MAX_LODS; // simplified versions of every mesh, 0 to keep only the meshes in the file
+	bool meshlets = true;        // split every mesh and level of detail into meshlets, see GenerateMeshlets
+	bool reorder = true;         // triangles for less overdraw and vertices in the order they're used, see OptimizeMeshOrder
+	MeshLayout layout = MeshLayout::INTERLEAVED;
+};
+
 template <minVertex vertexType = Vertex>
 struct Object3D
 {
@@ -25,11 +43,33 @@ struct Object3D
 	Vec3f rotation;
 	Vec3f scale;
 
-	[[nodiscard]] RESULT_VALUE LoadFromFile(std::filesystem::path filePath);
+	// A mesh is drawn with lods[i] once its projected size in pixels, the larger side of the screen rect around its AABB,
+	// is under lodScreenSizes[i]. Each one should be smaller than the one before, an object seen up close wants bigger ones
+	float lodScreenSizes[MAX_LODS] = { 256.0f, 128.0f, 64.0f, 32.0f };
+
+	[[nodiscard]] RESULT_VALUE LoadFromFile(std::filesystem::path filePath, const LoadOptions& options = {});
+
+	// level to draw the mesh at, 0 for the mesh itself and i for meshArr[meshIndex].lods[i - 1]
+	size_t SelectLOD(size_t meshIndex, float screenSize) const noexcept;
 };
 
 template<minVertex vertexType>
-inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path filePath)
+inline size_t Object3D<vertexType>::SelectLOD(size_t meshIndex, float screenSize) const noexcept
+{
+	const A::array<Mesh<vertexType>>& lods = meshArr[meshIndex].lods;
+	size_t level = 0;
+
+	// an empty level ran out of memory while loading, so did every one after it
+	while (level < lods.size() && lods[level].IndexCount() > 0 && screenSize < lodScreenSizes[level])
+	{
+		level++;
+	}
+
+	return level;
+}
+
+template<minVertex vertexType>
+inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path filePath, const LoadOptions& options)
 {
     RESULT_VALUE r_value = RESULT_VALUE::OK;
 
@@ -52,7 +92,8 @@ inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path fil
         aiProcess_OptimizeGraph |
         aiProcess_LimitBoneWeights |
         aiProcess_CalcTangentSpace |
-        aiProcess_FindInvalidData
+        aiProcess_FindInvalidData |
+        aiProcess_GenBoundingBoxes // fills mAABB, it's left empty otherwise
     );
 
     if (scene == nullptr)
@@ -75,6 +116,19 @@ inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path fil
         auto& vertices = meshArr[i].vertices;
         vertices.make_array(vertices, numVerts);
 
+        // AABBs
+        AABB aabb;
+        aabb.min = Vec3f{ _mesh->mAABB.mMin.x, _mesh->mAABB.mMin.y, _mesh->mAABB.mMin.z };
+        aabb.max = Vec3f{ _mesh->mAABB.mMax.x, _mesh->mAABB.mMax.y, _mesh->mAABB.mMax.z };
+
+        collisionBoxes.emplace_back(aabb);
+
+        // quantized positions are steps across the box of their mesh
+        if constexpr (quantizedVertex<vertexType>)
+        {
+            meshArr[i].SetQuantizationBox(aabb.min, aabb.max);
+        }
+
         for (size_t j = 0; j < numVerts; j++)
         {
             Vec3f positions;
@@ -93,15 +147,8 @@ inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path fil
             {
                 uvs = Vec2f{ _mesh->mTextureCoords[0][j].x, _mesh->mTextureCoords[0][j].y };
             }
-            vertices.emplace_back(Vertex{ positions, normals, uvs });
+            vertices.emplace_back(meshArr[i].Encode(Vertex{ positions, normals, uvs }));
         }
-
-        // AABBs
-        AABB aabb;
-        aabb.min = Vec3f{ _mesh->mAABB.mMin.x, _mesh->mAABB.mMin.y, _mesh->mAABB.mMin.z };
-        aabb.max = Vec3f{ _mesh->mAABB.mMax.x, _mesh->mAABB.mMax.y, _mesh->mAABB.mMax.z };
-
-        collisionBoxes.emplace_back(aabb);
     }
 
     // loop 1 to make all indices side-by-side in memory
@@ -125,6 +172,57 @@ inline RESULT_VALUE Object3D<vertexType>::LoadFromFile(std::filesystem::path fil
         }
     }
 
+    // loop 2, the simplified versions go after all of the full detail data
+    for (size_t i = 0; i < numMeshes; i++)
+    {
+        GenerateLODs(meshArr[i], options.lodLevels);
+
+        // the meshlets are built from runs of triangles, so they follow whatever order is left here
+        if (options.reorder)
+        {
+            OptimizeMeshOrder(meshArr[i]);
+
+            for (size_t j = 0; j < meshArr[i].lods.size(); j++)
+            {
+                OptimizeMeshOrder(meshArr[i].lods[j]);
+            }
+        }
+    }
+
+    if (options.meshlets)
+    {
+        for (size_t i = 0; i < numMeshes; i++)
+        {
+            GenerateMeshlets(meshArr[i]);
+
+            for (size_t j = 0; j < meshArr[i].lods.size(); j++)
+            {
+                GenerateMeshlets(meshArr[i].lods[j]);
+            }
+        }
+    }
+
+    // last, everything before reads the interleaved vertices and 32 bit indices
+    for (size_t i = 0; i < numMeshes; i++)
+    {
+        CompactIndices(meshArr[i]);
+
+        for (size_t j = 0; j < meshArr[i].lods.size(); j++)
+        {
+            CompactIndices(meshArr[i].lods[j]);
+        }
+
+        if (options.layout == MeshLayout::STREAMS)
+        {
+            ConvertToStreams(meshArr[i]);
+
+            for (size_t j = 0; j < meshArr[i].lods.size(); j++)
+            {
+                ConvertToStreams(meshArr[i].lods[j]);
+            }
+        }
+    }
+
     using namespace std;
 
     for (size_t i = 0; i < numMeshes; i++)
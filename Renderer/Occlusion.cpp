@@ -0,0 +1,98 @@
+#include "Occlusion.hpp"
+#include <algorithm>
+#include <limits>
+
+OcclusionBuffer::OcclusionBuffer() : m_depth(WIDTH * HEIGHT)
+{
+	Clear();
+}
+
+void OcclusionBuffer::SetCanvasSize(size_t width, size_t height) noexcept
+{
+	m_scaleX = static_cast<float>(WIDTH) / static_cast<float>(width);
+	m_scaleY = static_cast<float>(HEIGHT) / static_cast<float>(height);
+}
+
+void OcclusionBuffer::Clear() noexcept
+{
+	std::fill(m_depth.begin(), m_depth.end(), std::numeric_limits<unsigned short>::max());
+	m_hasOccluders = false;
+}
+
+void OcclusionBuffer::Rasterize(const RasterTriangle& triangle) noexcept
+{
+	static constexpr ScissorRect whole = { 0, 0, static_cast<int32_t>(WIDTH), static_cast<int32_t>(HEIGHT) };
+	const RenderTarget target = { nullptr, m_depth.data(), WIDTH, HEIGHT };
+
+	RasterTriangle scaled = triangle;
+	for (RasterVertex* v : { &scaled.a, &scaled.b, &scaled.c })
+	{
+		v->x *= m_scaleX;
+		v->y *= m_scaleY;
+	}
+
+	RasterizeTriangle(target, scaled, whole);
+	m_hasOccluders = true;
+}
+
+bool OcclusionBuffer::IsOccluded(const AABB& box, const Matrix4x4f& toClip) const noexcept
+{
+	if (!m_hasOccluders)
+	{
+		return false;
+	}
+
+	const BoxCorners corners = TransformCorners(box, toClip);
+
+	float minX = std::numeric_limits<float>::max(), maxX = std::numeric_limits<float>::lowest();
+	float minY = std::numeric_limits<float>::max(), maxY = std::numeric_limits<float>::lowest();
+	float nearestZ = 1.0f;
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		// behind the near plane the projection of a corner means nothing
+		if ((corners.outcode[i] & OUTCODE_NEAR) != 0)
+		{
+			return false;
+		}
+
+		// same mapping as the view port, x and y of [-1, 1] to [0, size]
+		const float invW = 1.0f / corners.w[i];
+		const float px = (corners.x[i] * invW * 0.5f + 0.5f) * WIDTH;
+		const float py = (-corners.y[i] * invW * 0.5f + 0.5f) * HEIGHT;
+
+		minX = std::min(minX, px);
+		maxX = std::max(maxX, px);
+		minY = std::min(minY, py);
+		maxY = std::max(maxY, py);
+		nearestZ = std::min(nearestZ, corners.z[i] * invW);
+	}
+
+	// Pixel centers are on integer coordinates. An occluder only has to cover the center of a pixel to write it, so the
+	// box is grown by a pixel on every side, which keeps occluder silhouettes from hiding what's partially behind them
+	const int32_t startX = std::max(static_cast<int32_t>(floorf(minX + 0.5f)) - 1, 0);
+	const int32_t startY = std::max(static_cast<int32_t>(floorf(minY + 0.5f)) - 1, 0);
+	const int32_t endX = std::min(static_cast<int32_t>(floorf(maxX + 0.5f)) + 1, static_cast<int32_t>(WIDTH) - 1);
+	const int32_t endY = std::min(static_cast<int32_t>(floorf(maxY + 0.5f)) + 1, static_cast<int32_t>(HEIGHT) - 1);
+
+	// off screen, that's for frustum culling to decide
+	if (startX > endX || startY > endY)
+	{
+		return false;
+	}
+
+	const unsigned short nearest = static_cast<unsigned short>(std::max(nearestZ, 0.0f) * std::numeric_limits<unsigned short>::max());
+
+	for (int32_t py = startY; py <= endY; py++)
+	{
+		for (int32_t px = startX; px <= endX; px++)
+		{
+			if (m_depth[py * WIDTH + px] >= nearest)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include "Rasterizer.hpp"
+#include "Collisions.hpp"
+#include <vector>
+
+// Small depth only buffer a few large occluders are drawn into before everything else, the bounding boxes
+// of the other objects are then tested against it so objects hidden behind the occluders never submit a triangle
+class OcclusionBuffer
+{
+public:
+	static constexpr size_t WIDTH = 256;
+	static constexpr size_t HEIGHT = 128;
+
+	OcclusionBuffer();
+
+	// occluder triangles come in canvas pixels and are scaled down to the buffer
+	void SetCanvasSize(size_t width, size_t height) noexcept;
+	void Clear() noexcept;
+	void Rasterize(const RasterTriangle& triangle) noexcept;
+
+	// True when every pixel the box covers has an occluder closer than the nearest point of the box.
+	// toClip takes the box to clip space, boxes crossing the near plane are never occluded
+	bool IsOccluded(const AABB& box, const Matrix4x4f& toClip) const noexcept;
+
+	bool HasOccluders() const noexcept { return m_hasOccluders; }
+
+private:
+	std::vector<unsigned short> m_depth;
+	float m_scaleX = 1.0f;
+	float m_scaleY = 1.0f;
+	bool m_hasOccluders = false;
+};
+
+#endif
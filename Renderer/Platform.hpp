@@ -0,0 +1,91 @@
+#ifndef PLATFORM_HPP
+#define PLATFORM_HPP
+
+#include "Color.hpp"
+#include <cstdint>
+#include <string_view>
+
+namespace Platform
+{
+	// Virtual key codes of the keys that aren't characters, the same values Win32 uses for its VK_ ones.
+	// Letters and digits are their upper case ASCII code
+	namespace Key
+	{
+		constexpr uint8_t LBUTTON = 0x01;
+		constexpr uint8_t RBUTTON = 0x02;
+		constexpr uint8_t MBUTTON = 0x04;
+		constexpr uint8_t SHIFT = 0x10;
+		constexpr uint8_t CONTROL = 0x11;
+		constexpr uint8_t LEFT = 0x25;
+		constexpr uint8_t UP = 0x26;
+		constexpr uint8_t RIGHT = 0x27;
+		constexpr uint8_t DOWN = 0x28;
+	}
+
+	// what the message pump saw, in the order it saw it
+	struct InputEvent
+	{
+		enum class Type : uint8_t
+		{
+			KEY_DOWN,
+			KEY_UP,
+			MOUSE_MOVE,
+			MOUSE_WHEEL
+		};
+
+		Type type = Type::KEY_DOWN;
+		uint8_t key = 0;    // virtual key code, mouse buttons included
+		int16_t x = 0;      // MOUSE_MOVE
+		int16_t y = 0;
+		int32_t wheel = 0;  // MOUSE_WHEEL
+	};
+
+	// Keyboard and mouse state rebuilt from the events, for threads other than the one pumping messages
+	struct InputState
+	{
+		bool keys[256] = {};
+		int16_t mouseX = 0;
+		int16_t mouseY = 0;
+		int32_t mouseWheel = 0;
+
+		bool KeyDown(uint8_t vkcode) const noexcept { return keys[vkcode]; }
+
+		void Apply(const InputEvent& event) noexcept
+		{
+			switch (event.type)
+			{
+				case InputEvent::Type::KEY_DOWN:    keys[event.key] = true; break;
+				case InputEvent::Type::KEY_UP:      keys[event.key] = false; break;
+				case InputEvent::Type::MOUSE_MOVE:  mouseX = event.x; mouseY = event.y; break;
+				case InputEvent::Type::MOUSE_WHEEL: mouseWheel = event.wheel; break;
+			}
+		}
+	};
+
+	// Where the frames of an Application go and where its time comes from, picked at Application::Start.
+	// Everything but Present is called from the thread running OnUpdate
+	class Backend
+	{
+	public:
+		virtual ~Backend() = default;
+
+		// handles whatever happened since the last frame, false once the application has to stop
+		virtual bool ProcessEvents() noexcept = 0;
+
+		// seconds the next OnUpdate stands for
+		virtual float FrameTime() noexcept = 0;
+
+		// Width * height pixels, the first row is the top one unless invertY. Called once per frame in order, from the
+		// raster stage, which isn't the thread running OnUpdate with a frame of latency (see Application::SetFrameLatency)
+		virtual void Present(const Color* pixels, size_t width, size_t height, bool invertY) noexcept = 0;
+
+		// Memory for back buffer index, width * height pixels, that Present can show as it is instead of copying it somewhere first.
+		// Called once per back buffer at Start. It belongs to the backend and stays valid as long as it does, nullptr leaves it to the Application
+		virtual Color* CreateBackBuffer([[maybe_unused]] size_t index, [[maybe_unused]] size_t width, [[maybe_unused]] size_t height) noexcept { return nullptr; }
+
+		virtual void SetTitle([[maybe_unused]] std::wstring_view name) noexcept {}
+		virtual void SetTitle([[maybe_unused]] std::string_view name) noexcept {}
+	};
+}
+
+#endif
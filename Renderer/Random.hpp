@@ -2,7 +2,9 @@
 #define RANDOM_HPP
 
 #include <random>
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
 #include <climits>
 #include "NaiveMath.hpp"
 
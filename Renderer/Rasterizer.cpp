@@ -0,0 +1,534 @@
+#include "Rasterizer.hpp"
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
+#include <limits>
+#include <utility>
+
+// vertices are snapped to 1/16th of a pixel, with 32 bit edge functions that keeps exact coverage for any
+// triangle whose bounding box is below 2^23 pixels in area (a 4K canvas fits)
+static constexpr int32_t SUBPIXEL_BITS = 4;
+static constexpr int32_t SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+static constexpr int64_t MAX_BOUNDS_AREA = int64_t(1) << 23;
+
+// a group of 8 pixels may start up to 7 pixels before the bounding box and end up to 7 after it
+static constexpr int32_t GROUP_OVERHANG = 8;
+
+struct EdgeFunction
+{
+	int32_t stepX; // change when moving one pixel to the right
+	int32_t stepY; // change when moving one pixel down
+	int64_t origin; // value at pixel (0, 0), already biased by the fill rule
+};
+
+// E(p) = (b - a) x (p - a), positive on the inner side of a clockwise (in screen space) triangle
+static inline EdgeFunction MakeEdge(int32_t ax, int32_t ay, int32_t bx, int32_t by) noexcept
+{
+	const int32_t A = ay - by;
+	const int32_t B = bx - ax;
+
+	// top-left rule: pixels exactly on a top or left edge are drawn, on the others they're not,
+	// so two triangles sharing an edge never write the same pixel twice
+	const bool topLeft = (A > 0) || (A == 0 && B > 0);
+
+	EdgeFunction edge;
+	edge.stepX = A * SUBPIXEL_ONE;
+	edge.stepY = B * SUBPIXEL_ONE;
+	edge.origin = -(int64_t(A) * ax + int64_t(B) * ay) - (topLeft ? 0 : 1);
+
+	return edge;
+}
+
+// triangle snapped to the subpixel grid, v1 and v2 swapped when needed so the area is positive
+struct SnappedTriangle
+{
+	const RasterVertex* v0;
+	const RasterVertex* v1;
+	const RasterVertex* v2;
+	int32_t x0, y0;
+	int32_t x1, y1;
+	int32_t x2, y2;
+	int64_t area;
+};
+
+// fixed point setup, pixel centers sit on integer coordinates. False for a degenerate triangle
+static inline bool SnapTriangle(const RasterTriangle& triangle, SnappedTriangle& out) noexcept
+{
+	out.v0 = &triangle.a;
+	out.v1 = &triangle.b;
+	out.v2 = &triangle.c;
+
+	out.x0 = static_cast<int32_t>(floorf(out.v0->x * SUBPIXEL_ONE + 0.5f));
+	out.y0 = static_cast<int32_t>(floorf(out.v0->y * SUBPIXEL_ONE + 0.5f));
+	out.x1 = static_cast<int32_t>(floorf(out.v1->x * SUBPIXEL_ONE + 0.5f));
+	out.y1 = static_cast<int32_t>(floorf(out.v1->y * SUBPIXEL_ONE + 0.5f));
+	out.x2 = static_cast<int32_t>(floorf(out.v2->x * SUBPIXEL_ONE + 0.5f));
+	out.y2 = static_cast<int32_t>(floorf(out.v2->y * SUBPIXEL_ONE + 0.5f));
+
+	out.area = int64_t(out.x1 - out.x0) * (out.y2 - out.y0) - int64_t(out.y1 - out.y0) * (out.x2 - out.x0);
+	if (out.area == 0)
+	{
+		return false;
+	}
+
+	// back faces were culled already, so take either winding
+	if (out.area < 0)
+	{
+		std::swap(out.v1, out.v2);
+		std::swap(out.x1, out.x2);
+		std::swap(out.y1, out.y2);
+		out.area = -out.area;
+	}
+
+	return true;
+}
+
+// perspective correct texturing of 8 pixels from their barycentric weights: 1/w is linear in screen space, u/w and v/w too
+struct TextureSampler
+{
+	__m256 wBase, wD1, wD2;
+	__m256 uBase, uD1, uD2;
+	__m256 vBase, vD1, vD2;
+	__m256 texMaxX;
+	__m256 texMaxY;
+	__m256i texWidth;
+	const int* texels = nullptr; // null samples black
+};
+
+static inline TextureSampler MakeSampler(const SnappedTriangle& t, const Image* texture) noexcept
+{
+	TextureSampler sampler;
+
+	const float invW0 = t.v0->invW, invW1 = t.v1->invW, invW2 = t.v2->invW;
+	const float u0 = t.v0->u * invW0, u1 = t.v1->u * invW1, u2 = t.v2->u * invW2;
+	const float t0 = t.v0->v * invW0, t1 = t.v1->v * invW1, t2 = t.v2->v * invW2;
+
+	sampler.wBase = _mm256_set1_ps(invW0); sampler.wD1 = _mm256_set1_ps(invW1 - invW0); sampler.wD2 = _mm256_set1_ps(invW2 - invW0);
+	sampler.uBase = _mm256_set1_ps(u0);    sampler.uD1 = _mm256_set1_ps(u1 - u0);       sampler.uD2 = _mm256_set1_ps(u2 - u0);
+	sampler.vBase = _mm256_set1_ps(t0);    sampler.vD1 = _mm256_set1_ps(t1 - t0);       sampler.vD2 = _mm256_set1_ps(t2 - t0);
+
+	const bool hasTexture = texture != nullptr && texture->pixelGrid != nullptr && texture->width > 0;
+	sampler.texMaxX = _mm256_set1_ps(hasTexture ? static_cast<float>(texture->width - 1) : 0.0f);
+	sampler.texMaxY = _mm256_set1_ps(hasTexture ? static_cast<float>(texture->height - 1) : 0.0f);
+	sampler.texWidth = _mm256_set1_epi32(hasTexture ? texture->width : 0);
+	sampler.texels = hasTexture ? reinterpret_cast<const int*>(texture->pixelGrid) : nullptr;
+
+	return sampler;
+}
+
+// texels of the lanes in mask, the others and out of range coordinates read as black just like Image::sample
+static inline __m256i SampleTexels(const TextureSampler& s, __m256 l1, __m256 l2, __m256i mask) noexcept
+{
+	if (s.texels == nullptr)
+	{
+		return _mm256_setzero_si256();
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	const __m256 invW = _mm256_fmadd_ps(l2, s.wD2, _mm256_fmadd_ps(l1, s.wD1, s.wBase));
+	const __m256 u = _mm256_div_ps(_mm256_fmadd_ps(l2, s.uD2, _mm256_fmadd_ps(l1, s.uD1, s.uBase)), invW);
+	const __m256 v = _mm256_div_ps(_mm256_fmadd_ps(l2, s.vD2, _mm256_fmadd_ps(l1, s.vD1, s.vBase)), invW);
+
+	const __m256 inRange = _mm256_and_ps
+	(
+		_mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)),
+		_mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, one, _CMP_LE_OQ))
+	);
+	const __m256i fetch = _mm256_and_si256(_mm256_castps_si256(inRange), mask);
+
+	const __m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, s.texMaxX));
+	const __m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, s.texMaxY));
+	const __m256i offsets = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(ty, s.texWidth), tx), _mm256_set1_epi32(sizeof(Color)));
+
+	// 4 byte gather of a 3 byte texel, images carry one byte of padding at the end for the last texel
+	return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), s.texels, offsets, fetch, 1);
+}
+
+// recomputes the farthest depth of the blocks and tiles touching the given pixel range (inclusive)
+static void UpdateHiZ(const RenderTarget& target, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY) noexcept
+{
+	using depthBufferType = std::remove_pointer_t<decltype(target.depth)>;
+
+	const size_t blocksPerRow = (target.width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	const size_t blocksPerColumn = (target.height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	const size_t tilesPerRow = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+
+	// a tile only gets closer when the block holding its farthest depth does
+	bool tilesChanged = false;
+
+	for (size_t by = minY / HIZ_BLOCK_SIZE; by <= maxY / HIZ_BLOCK_SIZE; by++)
+	{
+		const size_t startY = by * HIZ_BLOCK_SIZE;
+		const size_t endY = std::min(startY + HIZ_BLOCK_SIZE, target.height);
+
+		for (size_t bx = minX / HIZ_BLOCK_SIZE; bx <= maxX / HIZ_BLOCK_SIZE; bx++)
+		{
+			const size_t startX = bx * HIZ_BLOCK_SIZE;
+			depthBufferType farthest = 0;
+
+			if (startX + HIZ_BLOCK_SIZE <= target.width)
+			{
+				__m128i rowMax = _mm_setzero_si128();
+				for (size_t y = startY; y < endY; y++)
+				{
+					rowMax = _mm_max_epu16(rowMax, _mm_loadu_si128(reinterpret_cast<const __m128i*>(target.depth + y * target.width + startX)));
+				}
+
+				// there's only a horizontal min, so take it on the inverted values
+				farthest = static_cast<depthBufferType>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(rowMax, _mm_set1_epi32(-1)))));
+			}
+			else
+			{
+				for (size_t y = startY; y < endY; y++)
+				{
+					for (size_t x = startX; x < target.width; x++)
+					{
+						farthest = std::max(farthest, target.depth[y * target.width + x]);
+					}
+				}
+			}
+
+			depthBufferType& block = target.blockDepth[by * blocksPerRow + bx];
+			const size_t tile = (by * HIZ_BLOCK_SIZE / TILE_SIZE) * tilesPerRow + bx * HIZ_BLOCK_SIZE / TILE_SIZE;
+			tilesChanged |= farthest < block && block == target.tileDepth[tile];
+			block = farthest;
+		}
+	}
+
+	if (!tilesChanged)
+	{
+		return;
+	}
+
+	static constexpr size_t BLOCKS_PER_TILE = TILE_SIZE / HIZ_BLOCK_SIZE;
+
+	for (size_t ty = minY / TILE_SIZE; ty <= maxY / TILE_SIZE; ty++)
+	{
+		for (size_t tx = minX / TILE_SIZE; tx <= maxX / TILE_SIZE; tx++)
+		{
+			const size_t endBlockY = std::min((ty + 1) * BLOCKS_PER_TILE, blocksPerColumn);
+			const size_t endBlockX = std::min((tx + 1) * BLOCKS_PER_TILE, blocksPerRow);
+			depthBufferType farthest = 0;
+
+			for (size_t by = ty * BLOCKS_PER_TILE; by < endBlockY; by++)
+			{
+				for (size_t bx = tx * BLOCKS_PER_TILE; bx < endBlockX; bx++)
+				{
+					farthest = std::max(farthest, target.blockDepth[by * blocksPerRow + bx]);
+				}
+			}
+
+			target.tileDepth[ty * tilesPerRow + tx] = farthest;
+		}
+	}
+}
+
+void RasterizeTriangle(const RenderTarget& target, const RasterTriangle& triangle, const ScissorRect& scissor) noexcept
+{
+	using namespace std;
+	using depthBufferType = remove_pointer_t<decltype(target.depth)>;
+
+	static constexpr float depthMax = static_cast<float>(numeric_limits<depthBufferType>::max());
+
+	SnappedTriangle snapped;
+	if (!SnapTriangle(triangle, snapped))
+	{
+		return;
+	}
+
+	const RasterVertex* v0 = snapped.v0;
+	const RasterVertex* v1 = snapped.v1;
+	const RasterVertex* v2 = snapped.v2;
+	const int32_t x0 = snapped.x0, y0 = snapped.y0;
+	const int32_t x1 = snapped.x1, y1 = snapped.y1;
+	const int32_t x2 = snapped.x2, y2 = snapped.y2;
+
+	// pixel bounds clamped to the scissor, inclusive
+	const int32_t minX = max(static_cast<int32_t>((min({ x0, x1, x2 }) + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS), scissor.minX);
+	const int32_t minY = max(static_cast<int32_t>((min({ y0, y1, y2 }) + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS), scissor.minY);
+	const int32_t maxX = min(static_cast<int32_t>(max({ x0, x1, x2 }) >> SUBPIXEL_BITS), scissor.maxX - 1);
+	const int32_t maxY = min(static_cast<int32_t>(max({ y0, y1, y2 }) >> SUBPIXEL_BITS), scissor.maxY - 1);
+
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Nearest depth the triangle can write, one step lower since the interpolated depth may round below the vertices.
+	// Nothing can pass the depth test where the farthest depth isn't above it
+	const int32_t nearest = static_cast<int32_t>(min(max(min({ v0->z, v1->z, v2->z }), 0.0f), 1.0f) * depthMax) - 1;
+	const bool hasHiZ = target.blockDepth != nullptr;
+	const size_t blocksPerRow = (target.width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+
+	if (hasHiZ)
+	{
+		const size_t tilesPerRow = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+		bool hidden = true;
+
+		for (size_t ty = minY / TILE_SIZE; ty <= maxY / TILE_SIZE && hidden; ty++)
+		{
+			for (size_t tx = minX / TILE_SIZE; tx <= maxX / TILE_SIZE && hidden; tx++)
+			{
+				hidden = target.tileDepth[ty * tilesPerRow + tx] <= nearest;
+			}
+		}
+
+		if (hidden)
+		{
+			return;
+		}
+	}
+
+	// e0 is opposite to v0 and so on, which makes them the (scaled) barycentric weights of each vertex
+	const EdgeFunction e0 = MakeEdge(x1, y1, x2, y2);
+	const EdgeFunction e1 = MakeEdge(x2, y2, x0, y0);
+	const EdgeFunction e2 = MakeEdge(x0, y0, x1, y1);
+
+	// 8 pixel wide steps aligned to the canvas, identical alignment on every scissor keeps the results identical too
+	const int32_t startX = minX & ~7;
+
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i e0Lanes = _mm256_mullo_epi32(laneOffsets, _mm256_set1_epi32(e0.stepX));
+	const __m256i e1Lanes = _mm256_mullo_epi32(laneOffsets, _mm256_set1_epi32(e1.stepX));
+	const __m256i e2Lanes = _mm256_mullo_epi32(laneOffsets, _mm256_set1_epi32(e2.stepX));
+	const __m256i e0Step = _mm256_set1_epi32(e0.stepX * 8);
+	const __m256i e1Step = _mm256_set1_epi32(e1.stepX * 8);
+	const __m256i e2Step = _mm256_set1_epi32(e2.stepX * 8);
+
+	// z is linear in screen space
+	const __m256 invArea = _mm256_set1_ps(1.0f / static_cast<float>(snapped.area));
+	const __m256 zBase = _mm256_set1_ps(v0->z), zD1 = _mm256_set1_ps(v1->z - v0->z), zD2 = _mm256_set1_ps(v2->z - v0->z);
+	const __m256 depthScale = _mm256_set1_ps(depthMax);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	// Depth only targets have no color buffer, texturing is skipped along with the color writes.
+	// Visibility targets get the triangle id instead of a color, the texturing happens later in ResolveVisibility
+	const bool hasIds = target.ids != nullptr;
+	const bool hasColor = target.color != nullptr && !hasIds;
+	const TextureSampler sampler = MakeSampler(snapped, hasColor ? triangle.texture : nullptr);
+	const __m256i triangleId = _mm256_set1_epi32(static_cast<int32_t>(triangle.id));
+
+	const __m256i firstX = _mm256_set1_epi32(minX - 1);
+	const __m256i lastX = _mm256_set1_epi32(maxX + 1);
+
+	// pixel range actually written, only those blocks need their farthest depth refreshed
+	int32_t writtenMinX = maxX, writtenMaxX = minX;
+	int32_t writtenMinY = maxY, writtenMaxY = minY;
+
+	for (int32_t y = minY; y <= maxY; y++)
+	{
+		const int32_t e0Row = static_cast<int32_t>(e0.origin + int64_t(e0.stepX) * startX + int64_t(e0.stepY) * y);
+		const int32_t e1Row = static_cast<int32_t>(e1.origin + int64_t(e1.stepX) * startX + int64_t(e1.stepY) * y);
+		const int32_t e2Row = static_cast<int32_t>(e2.origin + int64_t(e2.stepX) * startX + int64_t(e2.stepY) * y);
+
+		__m256i w0 = _mm256_add_epi32(_mm256_set1_epi32(e0Row), e0Lanes);
+		__m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(e1Row), e1Lanes);
+		__m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(e2Row), e2Lanes);
+
+		const size_t rowIndex = static_cast<size_t>(y) * target.width;
+		const depthBufferType* blockRow = hasHiZ ? target.blockDepth + (y / HIZ_BLOCK_SIZE) * blocksPerRow : nullptr;
+
+		for (int32_t x = startX; x <= maxX; x += 8,
+			w0 = _mm256_add_epi32(w0, e0Step), w1 = _mm256_add_epi32(w1, e1Step), w2 = _mm256_add_epi32(w2, e2Step))
+		{
+			// coverage: inside all 3 edges and inside the clamped bounds
+			const __m256i laneX = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+			const __m256i inBounds = _mm256_and_si256(_mm256_cmpgt_epi32(laneX, firstX), _mm256_cmpgt_epi32(lastX, laneX));
+			const __m256i outside = _mm256_or_si256(_mm256_or_si256(w0, w1), w2);
+			const __m256i covered = _mm256_andnot_si256(_mm256_srai_epi32(outside, 31), inBounds);
+
+			if (_mm256_testz_si256(covered, covered))
+			{
+				continue;
+			}
+
+			// groups are aligned to the blocks, so a group is always inside of a single one
+			if (hasHiZ && blockRow[x / HIZ_BLOCK_SIZE] <= nearest)
+			{
+				continue;
+			}
+
+			const __m256 l1 = _mm256_mul_ps(_mm256_cvtepi32_ps(w1), invArea);
+			const __m256 l2 = _mm256_mul_ps(_mm256_cvtepi32_ps(w2), invArea);
+
+			// depth test, the row is only loaded as a whole when every lane belongs to this scissor
+			const __m256 z = _mm256_min_ps(_mm256_max_ps(_mm256_fmadd_ps(l2, zD2, _mm256_fmadd_ps(l1, zD1, zBase)), zero), one);
+			const __m256i newDepth = _mm256_cvttps_epi32(_mm256_mul_ps(z, depthScale));
+			depthBufferType* depthRow = target.depth + rowIndex + x;
+			const bool wholeGroup = x >= scissor.minX && x + 8 <= scissor.maxX;
+
+			__m256i oldDepth;
+			if (wholeGroup)
+			{
+				oldDepth = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depthRow)));
+			}
+			else
+			{
+				alignas(32) int32_t lanes[8] = {};
+				for (int32_t i = 0; i < 8; i++)
+				{
+					const int32_t px = x + i;
+					lanes[i] = (px >= minX && px <= maxX) ? depthRow[i] : 0;
+				}
+				oldDepth = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+			}
+
+			const __m256i pass = _mm256_and_si256(covered, _mm256_cmpgt_epi32(oldDepth, newDepth));
+			const uint32_t passMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+
+			if (passMask == 0)
+			{
+				continue;
+			}
+
+			writtenMinX = min(writtenMinX, max(x, minX));
+			writtenMaxX = max(writtenMaxX, min(x + 7, maxX));
+			writtenMinY = min(writtenMinY, y);
+			writtenMaxY = y;
+
+			const __m256i texel = SampleTexels(sampler, l1, l2, pass);
+
+			alignas(32) int32_t colors[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(colors), texel);
+			Color* colorRow = hasColor ? target.color + rowIndex + x : nullptr;
+			uint32_t* idRow = hasIds ? target.ids + rowIndex + x : nullptr;
+
+			if (passMask == 0xFF && wholeGroup)
+			{
+				const __m256i merged = _mm256_packus_epi32(newDepth, newDepth); // lanes 0-3 | 0-3 | 4-7 | 4-7
+				const __m128i packed = _mm256_castsi256_si128(_mm256_permute4x64_epi64(merged, _MM_SHUFFLE(3, 1, 2, 0)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(depthRow), packed);
+
+				for (int32_t i = 0; i < 8 && hasColor; i++)
+				{
+					memcpy(reinterpret_cast<unsigned char*>(&colorRow[i]), reinterpret_cast<const unsigned char*>(&colors[i]), sizeof(Color));
+				}
+
+				if (hasIds)
+				{
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(idRow), triangleId);
+				}
+			}
+			else
+			{
+				alignas(32) int32_t depths[8];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(depths), newDepth);
+
+				for (uint32_t bits = passMask; bits != 0; bits &= bits - 1)
+				{
+					const int32_t i = std::countr_zero(bits);
+					depthRow[i] = static_cast<depthBufferType>(depths[i]);
+					if (hasColor)
+					{
+						memcpy(reinterpret_cast<unsigned char*>(&colorRow[i]), reinterpret_cast<const unsigned char*>(&colors[i]), sizeof(Color));
+					}
+					if (hasIds)
+					{
+						idRow[i] = triangle.id;
+					}
+				}
+			}
+		}
+	}
+
+	if (hasHiZ && writtenMinX <= writtenMaxX && writtenMinY <= writtenMaxY)
+	{
+		UpdateHiZ(target, writtenMinX, writtenMinY, writtenMaxX, writtenMaxY);
+	}
+}
+
+void ResolveVisibility(const RenderTarget& target, const RasterTriangle* triangles, const ScissorRect& rect) noexcept
+{
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i empty = _mm256_set1_epi32(-1);
+
+	// neighbour pixels mostly belong to the same triangle, its setup is only redone when the id changes
+	uint32_t current = VISIBILITY_EMPTY;
+	SnappedTriangle snapped = {};
+	EdgeFunction e1 = {};
+	EdgeFunction e2 = {};
+	__m256 invArea = _mm256_setzero_ps();
+	TextureSampler sampler = {};
+
+	for (int32_t y = rect.minY; y < rect.maxY; y++)
+	{
+		const size_t rowIndex = static_cast<size_t>(y) * target.width;
+
+		for (int32_t x = rect.minX; x < rect.maxX; x += 8)
+		{
+			const int32_t lanes = std::min(8, rect.maxX - x);
+			uint32_t* idRow = target.ids + rowIndex + x;
+			Color* colorRow = target.color + rowIndex + x;
+
+			alignas(32) uint32_t ids[8];
+			for (int32_t i = 0; i < 8; i++)
+			{
+				ids[i] = i < lanes ? idRow[i] : VISIBILITY_EMPTY;
+			}
+
+			const __m256i idLanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(ids));
+			uint32_t pending = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(idLanes, empty)))) & 0xFF;
+
+			// one pass per distinct triangle in the group, every lane is textured by exactly one of them
+			while (pending != 0)
+			{
+				const uint32_t id = ids[std::countr_zero(pending)];
+
+				if (id != current)
+				{
+					// it passed the rasterizer, so it can't be degenerate
+					SnapTriangle(triangles[id], snapped);
+					e1 = MakeEdge(snapped.x2, snapped.y2, snapped.x0, snapped.y0);
+					e2 = MakeEdge(snapped.x0, snapped.y0, snapped.x1, snapped.y1);
+					invArea = _mm256_set1_ps(1.0f / static_cast<float>(snapped.area));
+					sampler = MakeSampler(snapped, triangles[id].texture);
+					current = id;
+				}
+
+				const __m256i same = _mm256_cmpeq_epi32(idLanes, _mm256_set1_epi32(static_cast<int32_t>(id)));
+				const uint32_t sameMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(same)));
+
+				// the very same weights the rasterizer had for these pixels
+				const int32_t e1Group = static_cast<int32_t>(e1.origin + int64_t(e1.stepX) * x + int64_t(e1.stepY) * y);
+				const int32_t e2Group = static_cast<int32_t>(e2.origin + int64_t(e2.stepX) * x + int64_t(e2.stepY) * y);
+				const __m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(e1Group), _mm256_mullo_epi32(laneOffsets, _mm256_set1_epi32(e1.stepX)));
+				const __m256i w2 = _mm256_add_epi32(_mm256_set1_epi32(e2Group), _mm256_mullo_epi32(laneOffsets, _mm256_set1_epi32(e2.stepX)));
+				const __m256 l1 = _mm256_mul_ps(_mm256_cvtepi32_ps(w1), invArea);
+				const __m256 l2 = _mm256_mul_ps(_mm256_cvtepi32_ps(w2), invArea);
+
+				alignas(32) int32_t colors[8];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(colors), SampleTexels(sampler, l1, l2, same));
+
+				for (uint32_t bits = sameMask; bits != 0; bits &= bits - 1)
+				{
+					const int32_t i = std::countr_zero(bits);
+					memcpy(reinterpret_cast<unsigned char*>(&colorRow[i]), reinterpret_cast<const unsigned char*>(&colors[i]), sizeof(Color));
+				}
+
+				pending &= ~sameMask;
+			}
+
+			// left empty for the next frame
+			for (int32_t i = 0; i < lanes; i++)
+			{
+				idRow[i] = VISIBILITY_EMPTY;
+			}
+		}
+	}
+}
+
+int32_t GuardBandMargin(size_t width, size_t height) noexcept
+{
+	// the whole guard band has to fit the area limit, every triangle within it does then too:
+	// (width + 2m) * (height + 2m) <= MAX_BOUNDS_AREA, solved for m
+	const double w = static_cast<double>(width + GROUP_OVERHANG);
+	const double h = static_cast<double>(height + GROUP_OVERHANG);
+	const double discriminant = (w + h) * (w + h) - 4.0 * (w * h - static_cast<double>(MAX_BOUNDS_AREA));
+	const int32_t margin = static_cast<int32_t>(floor((sqrt(discriminant) - (w + h)) / 4.0));
+
+	// the groups hanging past the canvas must still be inside of the band
+	return margin >= GROUP_OVERHANG ? margin : 0;
+}
@@ -0,0 +1,86 @@
+#ifndef RASTERIZER_HPP
+#define RASTERIZER_HPP
+
+#include "Images.hpp"
+#include <cstdint>
+
+// the screen is split into square tiles, each one is rasterized by a single thread so the frame buffer needs no locking
+static constexpr size_t TILE_SIZE = 64;
+
+// the depth buffer is summarized per HIZ_BLOCK_SIZE and TILE_SIZE squares, see RenderTarget
+static constexpr size_t HIZ_BLOCK_SIZE = 8;
+
+// id of a pixel no triangle was drawn to in a visibility buffer, see RenderTarget
+static constexpr uint32_t VISIBILITY_EMPTY = 0xFFFFFFFF;
+
+// post-clip vertex already mapped to the view port, it's all the rasterizer needs to know about a vertex
+struct RasterVertex
+{
+	float x;
+	float y;
+	float z;
+	float invW; // 1/w, for perspective correct interpolation
+	float u;
+	float v;
+};
+
+struct RasterTriangle
+{
+	RasterVertex a;
+	RasterVertex b;
+	RasterVertex c;
+	const Image* texture = nullptr; // drawn black without one
+	uint32_t id = 0; // what's written to a visibility buffer, see RenderTarget
+};
+
+// [min, max) pixel range a triangle is allowed to touch
+struct ScissorRect
+{
+	int32_t minX = 0;
+	int32_t minY = 0;
+	int32_t maxX = 0;
+	int32_t maxY = 0;
+};
+
+struct RenderTarget
+{
+	Color* color = nullptr; // may be null for a depth only target
+	unsigned short* depth = nullptr;
+	size_t width = 0;
+	size_t height = 0;
+
+	// Optional hierarchical z: the farthest depth of every HIZ_BLOCK_SIZE and TILE_SIZE square of the depth buffer, row major.
+	// A triangle is skipped for a whole block when it's behind all of it, and the blocks are kept up to date as pixels are written.
+	// Other writes to the depth buffer may leave them too far, which is still correct, they must be reset along with it though
+	unsigned short* blockDepth = nullptr;
+	unsigned short* tileDepth = nullptr;
+
+	// Optional visibility buffer, one id per pixel. When there's one triangles write their id to it instead of texturing the pixel,
+	// which is left for ResolveVisibility to do once the depth of the whole frame is known
+	uint32_t* ids = nullptr;
+};
+
+constexpr size_t HiZBlockCount(size_t width, size_t height) noexcept
+{
+	return ((width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE) * ((height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE);
+}
+
+constexpr size_t HiZTileCount(size_t width, size_t height) noexcept
+{
+	return ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+// Half-space rasterizer evaluating 8 pixels per step with AVX2, pixel centers are on integer coordinates.
+// Pixels outside of the scissor are never read or written, so the output of a triangle split across several
+// scissors is exactly the same as drawing it once with a scissor covering all of them
+void RasterizeTriangle(const RenderTarget& target, const RasterTriangle& triangle, const ScissorRect& scissor) noexcept;
+
+// Textures every pixel of the rect that has an id in target.ids, with triangles[id] sampled exactly as RasterizeTriangle would have,
+// and resets the ids to VISIBILITY_EMPTY. Rects that don't overlap can be resolved at the same time
+void ResolveVisibility(const RenderTarget& target, const RasterTriangle* triangles, const ScissorRect& rect) noexcept;
+
+// Pixels a triangle may reach past every edge of a width x height canvas and still be rasterized exactly,
+// so geometry only has to be clipped against this guard band instead of the screen edges. 0 when the canvas is too big for one
+int32_t GuardBandMargin(size_t width, size_t height) noexcept;
+
+#endif
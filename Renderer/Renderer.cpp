@@ -1,44 +1,85 @@
 #include "Renderer.hpp"
+#include <algorithm>
 #include <limits>
+#include <cmath>
 
 Application::~Application()
 {
+	StopSimulation();
+
 	for (size_t i = 0; i < BACKBUFFERCOUNT; ++i)
 	{
-		Allocator::Free(reinterpret_cast<void*&>(m_backBuffers[i]));
+		if (!m_backendBackBuffers[i])
+		{
+			Allocator::Free(reinterpret_cast<void*&>(m_backBuffers[i]));
+		}
 		Allocator::Free(reinterpret_cast<void*&>(m_alphaChannel[i]));
 	}
-	if (m_windowContext->m_hwnd && m_windowContext->m_hdc)
-	{
-		ReleaseDC(m_windowContext->m_hwnd, m_windowContext->m_hdc);
-	}
 	Allocator::Free(reinterpret_cast<void*&>(m_accumulationBuffer));
 }
 
-RESULT_VALUE Application::Start(uint16_t width, uint16_t height, std::wstring_view windowName, size_t bytesPrealloc, size_t maxManagedObjects, size_t alignment) noexcept
+RESULT_VALUE Application::Start([[maybe_unused]] uint16_t width, [[maybe_unused]] uint16_t height, [[maybe_unused]] std::wstring_view windowName,
+	[[maybe_unused]] size_t bytesPrealloc, [[maybe_unused]] size_t maxManagedObjects, [[maybe_unused]] size_t alignment) noexcept
 {
-	using depthBufferType = std::remove_pointer_t<decltype(m_depthBuffer)>;
+#ifdef _WIN32
+	SetCanvasSize(width, height);
 
-	canvasWidth = (width < 320) ? 320 : alignValue(width, 4);
-	canvasHeight = (height < 240) ? 240 : alignValue(height, 4);
+	return Run(std::make_unique<Platform::Window>((uint16_t)canvasWidth, (uint16_t)canvasHeight, windowName.data()), bytesPrealloc, maxManagedObjects, alignment);
+#else
+	return RESULT_VALUE::PLATFORM_UNAVAILABLE;
+#endif
+}
 
-	m_windowContext = std::make_unique<Platform::Window>((uint16_t)canvasWidth, (uint16_t)canvasHeight, windowName.data());
+RESULT_VALUE Application::Start(Platform::HeadlessOptions headless, uint16_t width, uint16_t height, size_t bytesPrealloc, size_t maxManagedObjects, size_t alignment) noexcept
+{
+	SetCanvasSize(width, height);
 
-	VPMatrix = ViewPortMatrix(canvasWidth, canvasHeight);
+	return Run(std::make_unique<Platform::Headless>(std::move(headless)), bytesPrealloc, maxManagedObjects, alignment);
+}
+
+void Application::SetCanvasSize(uint16_t width, uint16_t height) noexcept
+{
+	canvasWidth = RoundCanvasWidth(width);
+	canvasHeight = RoundCanvasHeight(height);
+}
+
+size_t Application::CanvasBufferBytes(uint16_t width, uint16_t height) noexcept
+{
+	using depthBufferType = std::remove_pointer_t<std::remove_extent_t<decltype(m_depthBuffer)>>;
+
+	const size_t canvasWidth = RoundCanvasWidth(width);
+	const size_t canvasHeight = RoundCanvasHeight(height);
+	const size_t canvasSize = canvasWidth * canvasHeight;
+
+	// everything CreateBackBuffers allocates, the back buffers are counted even when the backend has its own
+	const size_t perBackBuffer = canvasSize * (sizeof(Color) + sizeof(unsigned char) + sizeof(depthBufferType)) +
+		(HiZBlockCount(canvasWidth, canvasHeight) + HiZTileCount(canvasWidth, canvasHeight)) * sizeof(depthBufferType);
+
+	return perBackBuffer * BACKBUFFERCOUNT + canvasSize * sizeof(uint32_t);
+}
 
-	{	// Pre-allocation
-		const size_t backBuffersSize = size_t(width) * height * sizeof(Color) * BACKBUFFERCOUNT;
-		const size_t alphaChannelSize = size_t(width) * height * sizeof(unsigned char) * BACKBUFFERCOUNT;
-		const size_t depthBufferSize = size_t(width) * height * sizeof(depthBufferType);
-		const size_t accumulationBufferSize = size_t(width) * height * sizeof(uint32_t);
+RESULT_VALUE Application::Run(std::unique_ptr<Platform::Backend> backend, size_t bytesPrealloc, size_t maxManagedObjects, size_t alignment) noexcept
+{
+	m_backend = std::move(backend);
 
-		size_t toAllocate = backBuffersSize + alphaChannelSize + depthBufferSize + accumulationBufferSize;
+	VPMatrix = ViewPortMatrix(canvasWidth, canvasHeight);
+
+	// Pre-allocation, unless the allocator is already shared with others (e.g. several Applications rendering side by side)
+	if (!Allocator::IsInitialized())
+	{
+		size_t toAllocate = CanvasBufferBytes((uint16_t)canvasWidth, (uint16_t)canvasHeight);
 		// reserve
 		toAllocate += (bytesPrealloc == 0 ? MB(30) : bytesPrealloc);
 
 		Allocator::Init(toAllocate, alignment < 64 ? 64 : alignment, maxManagedObjects < 4096 ? 4096 : maxManagedObjects);
 	}
+
 	OnInit();
+	// only when OnInit didn't pick a count, so the pool isn't started just to be replaced
+	if (!m_renderThreadsSet)
+	{
+		SetRenderThreads(0);
+	}
 	CreateBackBuffers();
 
 	return Loop();
@@ -51,7 +92,7 @@ void Application::DrawPixelShader(const std::function<Color(uint16_t, uint16_t,
 	{
 		for (uint16_t x = 0; x < canvasWidth; x++)
 		{
-			const Color color = shader(x, y, params);
+			const Color color = shader(x, y, params...);
 			DrawPixel(x, y, color);
 		}
 	}
@@ -159,7 +200,6 @@ void Application::DrawLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, C
 			x = x2; y = y2; xe = x1;
 		}
 
-		m_depthBuffer[y * canvasWidth + x];
 		DrawPixel((uint16_t)x, (uint16_t)y, rgb);
 
 		for (i = 0; x < xe; i++)
@@ -289,26 +329,40 @@ void Application::DrawLine(const Vec2f& p0, const Vec2f& p1, Color rgb) noexcept
 	}
 }
 
-void Application::DrawLine(const Vec3f& p0, const Vec3f& p1, Color rgb) noexcept
+void Application::DrawTriangle(const RasterTriangle& triangle, size_t frame) noexcept
+{
+	const Vec3f a = { triangle.a.x, triangle.a.y, triangle.a.z };
+	const Vec3f b = { triangle.b.x, triangle.b.y, triangle.b.z };
+	const Vec3f c = { triangle.c.x, triangle.c.y, triangle.c.z };
+
+	DrawLine(a, b, { (unsigned char)255, (unsigned char)255, (unsigned char)255 }, frame);
+	DrawLine(b, c, { (unsigned char)255, (unsigned char)255, (unsigned char)255 }, frame);
+	DrawLine(c, a, { (unsigned char)255, (unsigned char)255, (unsigned char)255 }, frame);
+}
+
+void Application::DrawLine(const Vec3f& p0, const Vec3f& p1, Color rgb, size_t frame) noexcept
 {
 	using namespace std;
-	using depthBufferType = remove_pointer_t<decltype(m_depthBuffer)>;
+	using depthBufferType = remove_pointer_t<remove_extent_t<decltype(m_depthBuffer)>>;
 
 	static const float max = static_cast<float>(numeric_limits<depthBufferType>::max());
 	const depthBufferType Zvalue = static_cast<depthBufferType>(abs(p0.z * max));
 
-	static auto drawPixel = [&](int x, int y) noexcept -> void
+	depthBufferType* depthBuffer = m_depthBuffer[frame];
+	Color* backBuffer = m_backBuffers[frame];
+
+	const auto drawPixel = [&](int x, int y) noexcept -> void
 		{
 			if ((x < canvasWidth && y < canvasHeight))
 			{
 				const size_t index = static_cast<size_t>(y) * canvasWidth + x;
-				if (m_depthBuffer[index] > Zvalue)
+				if (depthBuffer[index] > Zvalue)
 				{
 					// write into z-buffer
-					m_depthBuffer[index] = Zvalue;// = Zvalue;
+					depthBuffer[index] = Zvalue;// = Zvalue;
 
 					// write into frame-buffer
-					memcpy(&m_backBuffers[presentBufferIndex][index], &rgb, sizeof(Color));
+					memcpy(&backBuffer[index], &rgb, sizeof(Color));
 				}
 			}
 		};
@@ -361,12 +415,12 @@ void Application::DrawLine(const Vec3f& p0, const Vec3f& p1, Color rgb) noexcept
 
 void Application::SetWindowTitle(std::wstring_view name) const noexcept
 {
-	SetWindowTextW(m_windowContext->m_hwnd, name.data());
+	m_backend->SetTitle(name);
 }
 
 void Application::SetWindowTitle(std::string_view name) const noexcept
 {
-	SetWindowTextA(m_windowContext->m_hwnd, name.data());
+	m_backend->SetTitle(name);
 }
 
 void Application::ClearScreenToogle(bool value) noexcept
@@ -379,6 +433,138 @@ void Application::InvertYaxis(bool value) noexcept
 	m_InvertYaxis = value;
 }
 
+void Application::SetGuardBand(bool enabled) noexcept
+{
+	m_guardBand = enabled;
+	UpdateGuardBand();
+}
+
+void Application::SetVisibilityBuffer(bool enabled) noexcept
+{
+	// whatever was drawn with the previous mode still has to be textured
+	WaitForRasterStage();
+	ResolveVisibility(presentBufferIndex);
+
+	m_visibilityBuffer = enabled;
+	for (size_t i = 0; i < BACKBUFFERCOUNT; i++)
+	{
+		if (enabled)
+		{
+			m_visibilityIds[i].assign(canvasWidth * canvasHeight, VISIBILITY_EMPTY);
+		}
+		else
+		{
+			m_visibilityIds[i] = {};
+			m_visibleTriangles[i] = {};
+		}
+	}
+}
+
+void Application::UpdateGuardBand() noexcept
+{
+	const int32_t margin = m_guardBand ? GuardBandMargin(canvasWidth, canvasHeight) : 0;
+
+	// the view port maps [-1, 1] to [0, size], so the band edge lands on 1 + margin / (size / 2)
+	m_guardBandX = 1.0f + static_cast<float>(margin) / static_cast<float>(canvasWidth / 2);
+	m_guardBandY = 1.0f + static_cast<float>(margin) / static_cast<float>(canvasHeight / 2);
+}
+
+void Application::SetRenderThreads(size_t count) noexcept
+{
+	// the frame in the background may be using the pool
+	WaitForRasterStage();
+	m_renderThreadsSet = true;
+
+	if (count == 0)
+	{
+		count = std::thread::hardware_concurrency();
+	}
+
+	if (count <= 1)
+	{
+		m_threadPool.reset();
+	}
+	else if (!m_threadPool || m_threadPool->WorkerCount() != count)
+	{
+		m_threadPool = std::make_unique<ThreadPool>(count);
+	}
+
+	m_workerGeometry.resize(m_threadPool ? m_threadPool->WorkerCount() : 0);
+}
+
+void Application::SetSimulationRate(float ticksPerSecond) noexcept
+{
+	StopSimulation();
+	m_simulationRate = ticksPerSecond;
+
+	if (m_looping)
+	{
+		StartSimulation();
+	}
+}
+
+void Application::StartSimulation() noexcept
+{
+	if (m_simulationRate > 0.0f)
+	{
+		m_simulationThread = std::jthread([this, ticksPerSecond = m_simulationRate](std::stop_token stop) noexcept
+			{
+				SimulationLoop(stop, ticksPerSecond);
+			});
+	}
+}
+
+void Application::StopSimulation() noexcept
+{
+	if (m_simulationThread.joinable())
+	{
+		m_simulationThread.request_stop();
+		m_simulationThread.join();
+	}
+}
+
+void Application::SimulationLoop(std::stop_token stop, float ticksPerSecond) noexcept
+{
+	using clock = std::chrono::steady_clock;
+
+	// ticks further behind than this are dropped instead of being caught up with (a breakpoint, a very long tick...)
+	static constexpr int32_t MAX_LATE_TICKS = 5;
+
+	const float dt = 1.0f / ticksPerSecond;
+	const clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / ticksPerSecond));
+	clock::time_point next = clock::now();
+
+	while (!stop.stop_requested())
+	{
+		Platform::InputEvent event;
+		while (Platform::Window::PollEvent(event))
+		{
+			m_simulationInput.Apply(event);
+		}
+
+		OnSimulate(dt, m_simulationInput, m_simulationScene);
+		m_simulationScene.tick++;
+		m_simulationScene.time += dt;
+
+		// the copy reuses the memory of the snapshot it overwrites
+		m_snapshots.Back() = m_simulationScene;
+		m_snapshots.Publish();
+
+		next += period;
+		if (clock::now() - next > period * MAX_LATE_TICKS)
+		{
+			next = clock::now();
+		}
+		std::this_thread::sleep_until(next);
+	}
+}
+
+void Application::SetFrameLatency(size_t frames) noexcept
+{
+	WaitForRasterStage();
+	m_frameLatency = std::min(frames, BACKBUFFERCOUNT - 1);
+}
+
 void Application::CreateBackBuffers()
 {
 	const size_t canvasSize = canvasWidth * canvasHeight;
@@ -402,13 +588,42 @@ void Application::CreateBackBuffers()
 	{
 		if (m_backBuffers[i] == nullptr)
 		{
-			// RGB
-			logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_backBuffers[i]), canvasSize * sizeof(Color)));
+			// RGB, in memory the backend presents from when it has some
+			m_backBuffers[i] = m_backend->CreateBackBuffer(i, canvasWidth, canvasHeight);
+			m_backendBackBuffers[i] = m_backBuffers[i] != nullptr;
+
+			if (!m_backendBackBuffers[i])
+			{
+				logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_backBuffers[i]), canvasSize * sizeof(Color)));
+			}
 		}
 	}
 
 	// will always access it also
-	logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_depthBuffer), canvasSize * sizeof(unsigned char)));
+	using depthBufferType = std::remove_pointer_t<std::remove_extent_t<decltype(m_depthBuffer)>>;
+	for (size_t i = 0; i < BACKBUFFERCOUNT; i++)
+	{
+		logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_depthBuffer[i]), canvasSize * sizeof(depthBufferType)));
+		logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_hiZBlocks[i]), HiZBlockCount(canvasWidth, canvasHeight) * sizeof(depthBufferType)));
+		logResult(Allocator::Allocate(reinterpret_cast<void*&>(m_hiZTiles[i]), HiZTileCount(canvasWidth, canvasHeight) * sizeof(depthBufferType)));
+	}
+
+	// tile bins, the last row/column of tiles may be partially outside of the canvas
+	tilesX = (canvasWidth + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (canvasHeight + TILE_SIZE - 1) / TILE_SIZE;
+	for (size_t i = 0; i < BACKBUFFERCOUNT; i++)
+	{
+		m_tileBins[i].resize(tilesX * tilesY);
+		m_activeTiles[i].reserve(tilesX * tilesY);
+	}
+
+	UpdateGuardBand();
+	m_occlusionBuffer.SetCanvasSize(canvasWidth, canvasHeight);
+
+	for (size_t i = 0; i < BACKBUFFERCOUNT && m_visibilityBuffer; i++)
+	{
+		m_visibilityIds[i].assign(canvasSize, VISIBILITY_EMPTY);
+	}
 }
 
 void Application::DrawPixelAccumulate(uint16_t x, uint16_t y, Color rgb, size_t currentSampleIndex) noexcept
@@ -447,80 +662,363 @@ void Application::DrawPixelAccumulate(uint16_t x, uint16_t y, uint8_t red, uint8
 	presentSampleIndex = currentSampleIndex;
 }
 
-void Application::Present() noexcept
+void Application::FlushTriangles(size_t frame) noexcept
 {
-	const BITMAPINFO bmi = 
+	std::vector<RasterTriangle>& triangles = m_rasterTriangles[frame];
+
+	if (triangles.empty())
 	{
-		.bmiHeader = {.biSize = sizeof(bmi.bmiHeader),
-		.biWidth = static_cast<LONG>(canvasWidth),
-		.biHeight = static_cast<LONG>(m_InvertYaxis ? static_cast<int16_t>(canvasHeight) : -static_cast<int16_t>(canvasHeight)),
-		.biPlanes = 1,
-		.biBitCount = 24,
-		.biCompression = BI_RGB
-	}};
+		return;
+	}
 
-	SetDIBitsToDevice
-	(
-		m_windowContext->m_hdc, 
-		0, 
-		0, 
-		(int16_t)canvasWidth,
-		(int16_t)canvasHeight,
-		0, 
-		0, 
-		0, 
-		(int16_t)canvasHeight,
-		m_backBuffers[presentBufferIndex], 
-		&bmi, 
-		DIB_RGB_COLORS
-	);
+	RenderTarget target = { m_backBuffers[frame], m_depthBuffer[frame], canvasWidth, canvasHeight, m_hiZBlocks[frame], m_hiZTiles[frame] };
+
+	// the ids are indices into the triangles of the whole frame
+	if (m_visibilityBuffer)
+	{
+		const uint32_t firstId = static_cast<uint32_t>(m_visibleTriangles[frame].size());
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			triangles[i].id = firstId + static_cast<uint32_t>(i);
+		}
+
+		m_visibleTriangles[frame].insert(m_visibleTriangles[frame].end(), triangles.begin(), triangles.end());
+		target.ids = m_visibilityIds[frame].data();
+	}
+
+	if (!m_threadPool)
+	{
+		const ScissorRect canvas = { 0, 0, static_cast<int32_t>(canvasWidth), static_cast<int32_t>(canvasHeight) };
+
+		for (const RasterTriangle& triangle : triangles)
+		{
+			RasterizeTriangle(target, triangle, canvas);
+		}
+	}
+	else
+	{
+		BinTriangles(frame);
+
+		std::vector<std::vector<uint32_t>>& tileBins = m_tileBins[frame];
+		std::vector<uint32_t>& activeTiles = m_activeTiles[frame];
+
+		// one job per tile that got something, every tile is owned by exactly one thread so no locking is needed
+		m_threadPool->Dispatch(activeTiles.size(), [&](size_t job, size_t) noexcept
+			{
+				const size_t tile = activeTiles[job];
+				const int32_t minX = static_cast<int32_t>((tile % tilesX) * TILE_SIZE);
+				const int32_t minY = static_cast<int32_t>((tile / tilesX) * TILE_SIZE);
+				const ScissorRect scissor =
+				{
+					minX,
+					minY,
+					std::min(minX + static_cast<int32_t>(TILE_SIZE), static_cast<int32_t>(canvasWidth)),
+					std::min(minY + static_cast<int32_t>(TILE_SIZE), static_cast<int32_t>(canvasHeight))
+				};
+
+				for (const uint32_t index : tileBins[tile])
+				{
+					RasterizeTriangle(target, triangles[index], scissor);
+				}
+			});
+
+		for (const uint32_t tile : activeTiles)
+		{
+			tileBins[tile].clear();
+		}
+		activeTiles.clear();
+	}
+
+	triangles.clear();
+}
+
+void Application::ResolveVisibility(size_t frame) noexcept
+{
+	const std::vector<RasterTriangle>& triangles = m_visibleTriangles[frame];
+
+	if (triangles.empty())
+	{
+		return;
+	}
+
+	RenderTarget target = { m_backBuffers[frame], m_depthBuffer[frame], canvasWidth, canvasHeight };
+	target.ids = m_visibilityIds[frame].data();
+
+	if (!m_threadPool)
+	{
+		::ResolveVisibility(target, triangles.data(), { 0, 0, static_cast<int32_t>(canvasWidth), static_cast<int32_t>(canvasHeight) });
+	}
+	else
+	{
+		// every pixel is visited no matter what was drawn, rows of tiles are plenty to spread it
+		m_threadPool->Dispatch(tilesY, [&](size_t job, size_t) noexcept
+			{
+				const int32_t minY = static_cast<int32_t>(job * TILE_SIZE);
+				const ScissorRect rows = { 0, minY, static_cast<int32_t>(canvasWidth), std::min(minY + static_cast<int32_t>(TILE_SIZE), static_cast<int32_t>(canvasHeight)) };
+
+				::ResolveVisibility(target, triangles.data(), rows);
+			});
+	}
+
+	m_visibleTriangles[frame].clear();
+}
+
+void Application::RasterizeFrame(size_t frame) noexcept
+{
+	FlushTriangles(frame);
+
+	for (const RasterTriangle& triangle : m_wireframeTriangles[frame])
+	{
+		DrawTriangle(triangle, frame);
+	}
+	m_wireframeTriangles[frame].clear();
+
+	ResolveVisibility(frame);
+	Present(frame);
+}
+
+void Application::WaitForRasterStage() noexcept
+{
+	if (m_rasterStage.valid())
+	{
+		m_rasterStage.get();
+	}
+}
+
+void Application::ExecuteCommands() noexcept
+{
+	if (m_commands.empty())
+	{
+		return;
+	}
+
+	// Roughly front to back so the depth test rejects as much as it can, but depths within a quarter of an octave are considered the same
+	// and sorted by texture instead. Objects behind the camera sort first, they're mostly culled anyway
+	const auto depthBucket = [](float depth) noexcept -> int32_t
+		{
+			return depth > 0.0f ? static_cast<int32_t>(std::floor(std::log2(depth) * 4.0f)) : std::numeric_limits<int32_t>::min();
+		};
+
+	m_commandOrder.resize(m_commands.size());
+	for (size_t i = 0; i < m_commandOrder.size(); i++)
+	{
+		m_commandOrder[i] = static_cast<uint32_t>(i);
+	}
+
+	std::stable_sort(m_commandOrder.begin(), m_commandOrder.end(), [&](uint32_t left, uint32_t right) noexcept
+		{
+			const DrawCommand& a = m_commands[left];
+			const DrawCommand& b = m_commands[right];
+			const int32_t bucketA = depthBucket(a.depth);
+			const int32_t bucketB = depthBucket(b.depth);
+
+			if (bucketA != bucketB)
+			{
+				return bucketA < bucketB;
+			}
+			if (a.texture != b.texture)
+			{
+				return std::less<const Image*>()(a.texture, b.texture);
+			}
+			return a.depth < b.depth;
+		});
+
+	// geometry stage, every command keeps its own triangles
+	if (m_commandTriangles.size() < m_commands.size())
+	{
+		m_commandTriangles.resize(m_commands.size());
+	}
+
+	if (!m_threadPool)
+	{
+		for (size_t i = 0; i < m_commandOrder.size(); i++)
+		{
+			const DrawCommand& command = m_commands[m_commandOrder[i]];
+			command.process(*this, command, m_geometry, m_frameStats, m_commandTriangles[i]);
+		}
+	}
+	else
+	{
+		std::vector<CullingStats> workerStats(m_threadPool->WorkerCount());
+
+		m_threadPool->Dispatch(m_commandOrder.size(), [&](size_t job, size_t worker) noexcept
+			{
+				const DrawCommand& command = m_commands[m_commandOrder[job]];
+				command.process(*this, command, m_workerGeometry[worker], workerStats[worker], m_commandTriangles[job]);
+			});
+
+		for (const CullingStats& stats : workerStats)
+		{
+			m_frameStats.objectsTested += stats.objectsTested;
+			m_frameStats.objectsCulled += stats.objectsCulled;
+			m_frameStats.objectsOccluded += stats.objectsOccluded;
+			m_frameStats.meshesTested += stats.meshesTested;
+			m_frameStats.meshesCulled += stats.meshesCulled;
+			m_frameStats.meshletsTested += stats.meshletsTested;
+			m_frameStats.meshletsCulled += stats.meshletsCulled;
+			m_frameStats.trianglesTested += stats.trianglesTested;
+			m_frameStats.trianglesCulled += stats.trianglesCulled;
+		}
+	}
+
+	// queued in the sorted order for the raster stage, wireframes apart since they're drawn over the filled triangles
+	for (size_t i = 0; i < m_commandOrder.size(); i++)
+	{
+		std::vector<RasterTriangle>& queue = m_commands[m_commandOrder[i]].wireframe ? m_wireframeTriangles[presentBufferIndex] : m_rasterTriangles[presentBufferIndex];
+		queue.insert(queue.end(), m_commandTriangles[i].begin(), m_commandTriangles[i].end());
+		m_commandTriangles[i].clear();
+	}
+
+	m_commands.clear();
+}
+
+void Application::BinTriangles(size_t frame) noexcept
+{
+	const std::vector<RasterTriangle>& triangles = m_rasterTriangles[frame];
 
-	presentBufferIndex = (presentBufferIndex + 1) % BACKBUFFERCOUNT;
+	const float maxX = static_cast<float>(canvasWidth - 1);
+	const float maxY = static_cast<float>(canvasHeight - 1);
+
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		const RasterTriangle& t = triangles[i];
+
+		// conservative pixel bounds, anything the rasterizer may touch is inside of it
+		const float left   = std::clamp(std::floor(std::min({ t.a.x, t.b.x, t.c.x })), 0.0f, maxX);
+		const float right  = std::clamp(std::ceil(std::max({ t.a.x, t.b.x, t.c.x })), 0.0f, maxX);
+		const float top    = std::clamp(std::floor(std::min({ t.a.y, t.b.y, t.c.y })), 0.0f, maxY);
+		const float bottom = std::clamp(std::ceil(std::max({ t.a.y, t.b.y, t.c.y })), 0.0f, maxY);
+
+		const size_t tileMinX = static_cast<size_t>(left) / TILE_SIZE;
+		const size_t tileMaxX = static_cast<size_t>(right) / TILE_SIZE;
+		const size_t tileMinY = static_cast<size_t>(top) / TILE_SIZE;
+		const size_t tileMaxY = static_cast<size_t>(bottom) / TILE_SIZE;
+
+		for (size_t ty = tileMinY; ty <= tileMaxY; ty++)
+		{
+			for (size_t tx = tileMinX; tx <= tileMaxX; tx++)
+			{
+				std::vector<uint32_t>& bin = m_tileBins[frame][ty * tilesX + tx];
+				if (bin.empty())
+				{
+					m_activeTiles[frame].push_back(static_cast<uint32_t>(ty * tilesX + tx));
+				}
+				bin.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+}
+
+void Application::Present(size_t frame) noexcept
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	m_backend->Present(m_backBuffers[frame], canvasWidth, canvasHeight, m_InvertYaxis);
+	m_presentTime.store(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count(), std::memory_order_relaxed);
+
+	if (m_capture)
+	{
+		m_capture->Submit(m_backBuffers[frame], m_InvertYaxis);
+	}
+
+	if (m_stream)
+	{
+		m_stream->Submit(m_backBuffers[frame], m_InvertYaxis);
+	}
+}
+
+RESULT_VALUE Application::StartCapture(CaptureOptions options) noexcept
+{
+	std::error_code error;
+	std::filesystem::create_directories(options.outputDirectory, error);
+	if (error)
+	{
+		std::cerr << "Couldn't create " << options.outputDirectory.string() << ": " << error.message() << std::endl;
+		return RESULT_VALUE::GENERIC_ERROR;
+	}
+
+	// the frame in the background may be presenting into the capture being replaced
+	WaitForRasterStage();
+	m_capture = std::make_unique<FrameCapture>(canvasWidth, canvasHeight, std::move(options));
+
+	return RESULT_VALUE::OK;
 }
 
-void Application::ClearScreen() const noexcept
+CaptureStats Application::StopCapture() noexcept
 {
-	using depthBufferType = std::remove_pointer_t<decltype(m_depthBuffer)>;
+	WaitForRasterStage();
+
+	if (!m_capture)
+	{
+		return {};
+	}
+
+	m_capture->Finish();
+	const CaptureStats stats = m_capture->Stats();
+	m_capture.reset();
+
+	return stats;
+}
+
+RESULT_VALUE Application::StartStream(StreamOptions options) noexcept
+{
+	if (options.path.empty() && options.fileDescriptor == -1)
+	{
+		return RESULT_VALUE::MISSING_FILEPATH;
+	}
+
+	// the frame in the background may be presenting into the stream being replaced
+	WaitForRasterStage();
+	m_stream = std::make_unique<FrameStream>(canvasWidth, canvasHeight, std::move(options));
+
+	return RESULT_VALUE::OK;
+}
+
+StreamStats Application::StopStream() noexcept
+{
+	WaitForRasterStage();
+
+	if (!m_stream)
+	{
+		return {};
+	}
+
+	m_stream->Finish();
+	const StreamStats stats = m_stream->Stats();
+	m_stream.reset();
+
+	return stats;
+}
+
+void Application::ClearScreen() noexcept
+{
+	using depthBufferType = std::remove_pointer_t<std::remove_extent_t<decltype(m_depthBuffer)>>;
 
-	static size_t lastSampleIndex = presentSampleIndex;
 	const size_t canvasSize = (size_t)canvasWidth * canvasHeight;
 
 	memset(m_backBuffers[presentBufferIndex], 0x4D, canvasSize * sizeof(Color)); //  gray-ish
-	memset(m_depthBuffer, 0xFF, canvasSize * sizeof(depthBufferType));
+	memset(m_depthBuffer[presentBufferIndex], 0xFF, canvasSize * sizeof(depthBufferType));
+	memset(m_hiZBlocks[presentBufferIndex], 0xFF, HiZBlockCount(canvasWidth, canvasHeight) * sizeof(depthBufferType));
+	memset(m_hiZTiles[presentBufferIndex], 0xFF, HiZTileCount(canvasWidth, canvasHeight) * sizeof(depthBufferType));
 	
 	// clear accumulation buffer only if the current sample N is lower than the last update (in case camera moved etc... -> for static image raytracing)
-	if (presentSampleIndex < lastSampleIndex)
+	if (presentSampleIndex < m_lastSampleIndex)
 	{
 		memset(m_accumulationBuffer, 0, canvasSize * sizeof(uint32_t));
 	}
-	lastSampleIndex = presentSampleIndex;
+	m_lastSampleIndex = presentSampleIndex;
 }
 
 RESULT_VALUE Application::Loop()
 {
-	auto last = std::chrono::high_resolution_clock::now();
-	MSG msg = {};
-
 	float accumulatedTime = 0.0;
 	size_t frameCount = 0;
 
-	while (true)
-	{
-		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
-		{
-			if (msg.message == WM_QUIT) [[unlikely]]
-			{
-				return RESULT_VALUE::OK;
-			}
+	m_looping = true;
+	StartSimulation();
 
-			TranslateMessage(&msg);
-			DispatchMessageW(&msg);
-		}
-
-		const auto now = std::chrono::high_resolution_clock::now();
-		const auto elapsed = now - last;
-		last = now;
-		const float deltaTime = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / 1000.0f;
+	while (m_backend->ProcessEvents())
+	{
+		const float deltaTime = m_backend->FrameTime();
 
 		accumulatedTime += deltaTime;
 
@@ -531,16 +1029,40 @@ RESULT_VALUE Application::Loop()
 			frameCount = 0;
 		}
 
+		// with a frame of latency the previous frame may still be rasterizing, into the other back buffer
 		if (m_clearScreen)
 		{
 			ClearScreen();
 		}
+		m_occlusionBuffer.Clear();
 		OnUpdate(deltaTime);
-		Present();
+		ExecuteCommands();
+
+		if (m_frameLatency == 0)
+		{
+			RasterizeFrame(presentBufferIndex);
+		}
+		else
+		{
+			// fence: frames are presented in order, and this back buffer is only drawn into again once it's presented
+			WaitForRasterStage();
+			m_rasterStage = std::async(std::launch::async, [this, frame = presentBufferIndex]() noexcept
+				{
+					RasterizeFrame(frame);
+				});
+		}
+		presentBufferIndex = (presentBufferIndex + 1) % BACKBUFFERCOUNT;
+
+		m_lastFrameStats = m_frameStats;
+		m_frameStats = {};
 
 		++frameCount;
 		++frameIndex;
 	}
 
+	m_looping = false;
+	StopSimulation();
+	WaitForRasterStage();
+
 	return RESULT_VALUE::OK;
 }
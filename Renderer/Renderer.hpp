@@ -2,20 +2,86 @@
 #define RT_RENDERER_HPP
 
 #include "Window.hpp"
+#include "Headless.hpp"
+#include "Capture.hpp"
+#include "Stream.hpp"
 #include "ErrorEnum.hpp"
 #include "Object3D.hpp"
 #include "Illumination.hpp"
 #include "Clipping.hpp"
+#include "Collisions.hpp"
+#include "Occlusion.hpp"
 #include "Cameras.hpp"
+#include "Rasterizer.hpp"
+#include "ThreadPool.hpp"
+#include "Transform.hpp"
+#include <atomic>
 #include <memory>
 #include <chrono>
 #include <functional>
 #include <future>
+#include <vector>
+
+// What Draw3DObject skipped during a frame, objects and meshes are culled by their bounding boxes before any of their triangles are read
+struct CullingStats
+{
+	size_t objectsTested = 0;
+	size_t objectsCulled = 0;
+	size_t objectsOccluded = 0; // behind the occluders, see DrawOccluder
+	size_t meshesTested = 0;
+	size_t meshesCulled = 0;
+	size_t meshletsTested = 0;
+	size_t meshletsCulled = 0; // outside of the frustum, facing away or occluded as a whole
+	size_t trianglesTested = 0;
+	size_t trianglesCulled = 0; // outside of the frustum or facing away
+};
+
+// Where an object is, same fields as Object3D has
+struct ObjectTransform
+{
+	Vec3f positionInSpace;
+	Vec3f rotation;
+	Vec3f scale = { 1.0f, 1.0f, 1.0f };
+
+	template <minVertex vertexType>
+	void ApplyTo(Object3D<vertexType>& object) const noexcept
+	{
+		object.positionInSpace = positionInSpace;
+		object.rotation = rotation;
+		object.scale = scale;
+	}
+};
+
+// State of the scene the simulation thread hands over to the rendering one, see Application::SetSimulationRate.
+// What the transforms and cameras are is up to the application, usually one transform per object
+struct SceneSnapshot
+{
+	std::vector<ObjectTransform> transforms;
+	std::vector<Camera> cameras;
+	size_t tick = 0;    // ticks simulated when it was taken
+	float time = 0.0f;  // seconds simulated when it was taken
+};
+
+// Scratch memory of the geometry stage, one for every thread running it
+struct GeometryContext
+{
+	VertexCache vertexCache; // post-transform vertices of the mesh being drawn
+	ClipPolygon clipPolygon;
+	std::vector<Matrix4x4f> instanceMatrices; // world view projection of the instances left after culling
+	std::vector<uint8_t> instanceLevels; // level of detail each of them draws the current mesh at, CULLED_LEVEL if it doesn't
+	std::vector<const Meshlet*> visibleMeshlets; // of the current mesh and instance
+};
 
 class Application
 {
 	static constexpr size_t BACKBUFFERCOUNT = 2;
 
+	// instances drawn between two flushes of the queued triangles by Draw3DObjectInstanced
+	static constexpr size_t INSTANCE_BATCH = 64;
+
+	// marks an instance the current mesh was culled for in GeometryContext::instanceLevels
+	static constexpr uint8_t CULLED_LEVEL = 0xFF;
+
 public:
 	Application() {}
 	virtual ~Application();
@@ -24,12 +90,27 @@ public:
 	virtual void OnUpdate(float dt) noexcept = 0;
 	virtual void OnInit() = 0;
 
+	// Called on the simulation thread once per tick, see SetSimulationRate. dt is always the tick length, input is the keyboard and mouse
+	// as of this tick and scene is the simulation's own copy, kept from tick to tick. A copy of it is published once this returns
+	virtual void OnSimulate([[maybe_unused]] float dt, [[maybe_unused]] const Platform::InputState& input, [[maybe_unused]] SceneSnapshot& scene) noexcept {}
+
 	// If gonna change the memory to be allocated, use the MB() / GB() functions for easiness
 	// The first 3 parameters define the window configuration. The title can be changed at any time through SetWindowTitle() but the screen width and height are fixed;
 	// Width or height that's below the default will be ignored, and any value will be aligned to 4, i.e. a width set to 737 will turn into 740;
 	// For maxManagedObjects and alignment, any value below the defaults are discarted, all in all you shouldn't need to change those but they're available nonetheless.
+	// The Allocator is initialized with the canvas buffers (see CanvasBufferBytes) plus bytesPrealloc, unless it already is: then it's shared with
+	// whatever initialized it, which has to leave room for CanvasBufferBytes, and bytesPrealloc, maxManagedObjects and alignment are ignored.
+	// The window is Win32 only, anywhere else it returns PLATFORM_UNAVAILABLE right away
 	RESULT_VALUE Start(uint16_t WindowWidth = 320, uint16_t WindowHeight = 240, std::wstring_view windowDefaultName = L"My Application", size_t bytesPrealloc = MB(30), size_t maxManagedObjects = 4096, size_t alignment = 64) noexcept;
 
+	// Same without a window, on any platform: the frames are rendered into the same back buffers and handed to headless.onFrame or written
+	// to headless.outputDirectory instead of being shown, and OnUpdate runs headless.frameCount times on a synthetic clock (see Platform::HeadlessOptions).
+	// There's no input, the window title is ignored. Returns once the last frame is presented
+	RESULT_VALUE Start(Platform::HeadlessOptions headless, uint16_t width = 320, uint16_t height = 240, size_t bytesPrealloc = MB(30), size_t maxManagedObjects = 4096, size_t alignment = 64) noexcept;
+
+	// bytes Start takes from the Allocator for the back buffers, depth buffers and the rest of a width x height canvas, rounded the same way
+	static size_t CanvasBufferBytes(uint16_t width, uint16_t height) noexcept;
+
 	template <typename... Args>
 	void DrawPixelShader(const std::function<Color(uint16_t, uint16_t, Args...)>& shader, Args&&... params) noexcept;
 	void DrawPixelShader(const std::function<Color(uint16_t, uint16_t)>& shader) noexcept;
@@ -43,33 +124,147 @@ public:
 	template <minVertex vertexType = Vertex>
 	void Draw3DObject(const Object3D<vertexType>& object, const Camera& camera, bool wireframe = false) noexcept;
 
+	// Deferred version of Draw3DObject: the draw is only recorded, and every draw recorded during OnUpdate is executed once it returns.
+	// They're sorted roughly front to back and by texture, and the objects are transformed and clipped on the render threads before
+	// all of their triangles are rasterized together. The camera is copied but the object must stay alive until the end of the frame
+	template <minVertex vertexType = Vertex>
+	void Submit3DObject(const Object3D<vertexType>& object, const Camera& camera, bool wireframe = false) noexcept;
+
+	// Draws the object once per world matrix of the contiguous instances array, its own position, rotation and scale are ignored.
+	// Every instance is culled on its own, but each mesh is only read once per INSTANCE_BATCH instances instead of once per draw
+	template <minVertex vertexType = Vertex>
+	void Draw3DObjectInstanced(const Object3D<vertexType>& object, const Camera& camera, const Matrix4x4f* instances, size_t instanceCount, bool wireframe = false) noexcept;
+
+	// Draws the object into the low resolution occlusion buffer only. Objects drawn after it in the same frame whose bounding box is
+	// completely behind the occluders are skipped. Meant for a few big objects (walls, terrain...), drawn first and then as usual
+	template <minVertex vertexType = Vertex>
+	void DrawOccluder(const Object3D<vertexType>& object, const Camera& camera) noexcept;
+
 	void SetWindowTitle(std::wstring_view name) const noexcept;
 	void SetWindowTitle(std::string_view name) const noexcept;
 	void ClearScreenToogle(bool value) noexcept;
 	void InvertYaxis(bool value) noexcept;
 
+	// Triangles poking out of the screen are left for the rasterizer to scissor instead of being clipped, only the ones reaching past
+	// a band around the screen are. Saves the clipping and the extra triangles it creates, the image is the same either way. On by default
+	void SetGuardBand(bool enabled) noexcept;
+
+	// Deferred texturing: triangles only write their depth and an id while the frame is drawn, then every visible pixel is textured once
+	// right before presenting instead of every time a triangle passes the depth test there. Pays off with a lot of overdraw, the image is the same.
+	// Anything else drawn during the frame (pixels, lines, images) ends up under the triangles covering it. Off by default
+	void SetVisibilityBuffer(bool enabled) noexcept;
+
+	// Number of threads used to rasterize the screen tiles, 0 picks one per hardware thread and 1 rasterizes on the calling thread.
+	// Both paths produce the exact same image, so it can be changed at any time
+	void SetRenderThreads(size_t count) noexcept;
+
+	// Frames rasterized and presented in the background while the next one is updated, 0 or 1. With 1 a frame is rasterized and presented
+	// while OnUpdate and the geometry stage of the Submit3DObject draws of the next one run, which costs a frame of latency.
+	// Immediate draws still happen right away, into the next frame's own buffers. 0 by default
+	void SetFrameLatency(size_t frames) noexcept;
+
+	// Runs OnSimulate on its own thread ticksPerSecond times per second, 0 stops it (the default). The rendering thread keeps running
+	// OnUpdate as fast as it can and reads the scene through LatestSnapshot, neither thread ever waits for the other.
+	// Input reaches the simulation as events (see Platform::Window::PollEvent), nothing else may poll them while it runs.
+	// The thread only runs along with the main loop: set before that (e.g. from OnInit) it starts with the first frame, and it's stopped
+	// before Start returns, so OnSimulate is never called once the derived class could be torn down
+	void SetSimulationRate(float ticksPerSecond) noexcept;
+
+	// Copies every presented frame into one of options.slotCount slots allocated up front, which encoder threads write to options.outputDirectory
+	// in the background (see FrameCapture). Presenting only pays for the copy, or for waiting on a slot with CapturePolicy::WAIT.
+	// Replaces the capture running, if any. Call it once the Application is started, e.g. from OnInit
+	RESULT_VALUE StartCapture(CaptureOptions options) noexcept;
+
+	// Waits until every frame captured is written, then returns what happened to them. Also done when the Application is destroyed
+	CaptureStats StopCapture() noexcept;
+
+	// so far, zeroes when there's no capture running
+	CaptureStats CaptureStatistics() const noexcept { return m_capture ? m_capture->Stats() : CaptureStats{}; }
+
+	// Writes every presented frame as raw BGR24 or Y4M video to options.path or options.fileDescriptor, e.g. a pipe into an encoder (see FrameStream).
+	// Presenting converts the frame into one of two buffers a writer thread empties, it never waits on the stream: frames are dropped instead.
+	// Replaces the stream running, if any. Call it once the Application is started, e.g. from OnInit
+	RESULT_VALUE StartStream(StreamOptions options) noexcept;
+
+	// Writes the frames still queued and closes the stream, then returns what happened to them. Also done when the Application is destroyed
+	StreamStats StopStream() noexcept;
+
+	// so far, zeroes when there's no stream running
+	StreamStats StreamStatistics() const noexcept { return m_stream ? m_stream->Stats() : StreamStats{}; }
+
+	// Scene published by the last simulation tick, left untouched until the next call. Only for the thread running OnUpdate
+	const SceneSnapshot& LatestSnapshot() noexcept { return m_snapshots.Latest(); }
+
 	constexpr size_t CanvasWidth() const noexcept { return canvasWidth; }
 	constexpr size_t CanvasHeight() const noexcept { return canvasHeight; }
 	constexpr size_t FrameIndex() const noexcept { return frameIndex; }
 	constexpr size_t FPS() const noexcept { return currentFPS; }
+	float PresentTime() const noexcept { return m_presentTime.load(std::memory_order_relaxed); } // milliseconds the backend took to show the last frame
+	// Of the last frame whose geometry was processed. With SetFrameLatency(1) that frame may still be rasterizing, so it's one ahead of the presented one
+	constexpr const CullingStats& FrameCullingStats() const noexcept { return m_lastFrameStats; }
 
 private:
+	// everything Start does once the canvas size is set and the backend is picked
+	RESULT_VALUE Run(std::unique_ptr<Platform::Backend> backend, size_t bytesPrealloc, size_t maxManagedObjects, size_t alignment) noexcept;
+	void SetCanvasSize(uint16_t width, uint16_t height) noexcept;
+	static size_t RoundCanvasWidth(uint16_t width) noexcept { return width < 320 ? 320 : alignValue(width, 4); }
+	static size_t RoundCanvasHeight(uint16_t height) noexcept { return height < 240 ? 240 : alignValue(height, 4); }
 	void CreateBackBuffers();
-	void Present() noexcept;
-	void ClearScreen() const noexcept;
+	void UpdateGuardBand() noexcept;
+	void Present(size_t frame) noexcept;
+	void ClearScreen() noexcept;
 	RESULT_VALUE Loop();
+	void SimulationLoop(std::stop_token stop, float ticksPerSecond) noexcept;
+	void StartSimulation() noexcept;
+	void StopSimulation() noexcept;
 
 	// mainly for raytracing
 	void DrawPixelAccumulate(uint16_t x, uint16_t y, Color rgb, size_t currentSampleIndex) noexcept;
 	void DrawPixelAccumulate(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue, size_t currentSampleIndex) noexcept;
 
-	// used exclusively inside Draw3DObject
-	template <minVertex vertexType = Vertex>
-	void DrawTriangle(const Triangle<vertexType>& triangle) noexcept;
+	// used exclusively inside Draw3DObject, frame is the index of the back buffer to draw into
+	void DrawTriangle(const RasterTriangle& triangle, size_t frame) noexcept;
 
-	template <minVertex vertexType = Vertex>
-	void DrawTexturedTriangle(const Triangle<vertexType>& triangle, const Image& texture) noexcept;
-	void DrawLine(const Vec3f& p0, const Vec3f& p1, Color rgb) noexcept;
+	// Culls, transforms and clips the triangles of an object, emit(const RasterTriangle&) gets every one left in screen space.
+	// Only reads the Application, so several threads may run it at once with their own context, stats and emit
+	template <minVertex vertexType, typename Emit>
+	void ProcessObject(const Object3D<vertexType>& object, const Camera& camera, GeometryContext& context, CullingStats& stats, bool testOcclusion, Emit&& emit) const noexcept;
+
+	// same for several copies of it, one world matrix each. The copies that survive culling share the staged vertices of every mesh
+	template <minVertex vertexType, typename Emit>
+	void ProcessInstances(const Object3D<vertexType>& object, const Camera& camera, const Matrix4x4f* worlds, size_t instanceCount, GeometryContext& context, CullingStats& stats, bool testOcclusion, Emit&& emit) const noexcept;
+
+	// draw recorded by Submit3DObject, process runs the geometry stage of the Object3D type it was recorded with
+	struct DrawCommand
+	{
+		const void* object = nullptr;
+		Camera camera;
+		Matrix4x4f world;
+		const Image* texture = nullptr; // of the first mesh, to sort by
+		float depth = 0.0f;             // view space depth of the object's center, to sort by
+		bool wireframe = false;
+		void (*process)(const Application&, const DrawCommand&, GeometryContext&, CullingStats&, std::vector<RasterTriangle>&) noexcept = nullptr;
+	};
+
+	template <minVertex vertexType>
+	static void ProcessCommand(const Application& app, const DrawCommand& command, GeometryContext& context, CullingStats& stats, std::vector<RasterTriangle>& triangles) noexcept;
+
+	// geometry stage of every recorded draw of the frame, the triangles are queued for RasterizeFrame. See Submit3DObject
+	void ExecuteCommands() noexcept;
+	void DrawLine(const Vec3f& p0, const Vec3f& p1, Color rgb, size_t frame) noexcept;
+
+	// rasterizes every queued triangle of a frame, binning them into screen tiles when there's more than one render thread
+	void FlushTriangles(size_t frame) noexcept;
+	void BinTriangles(size_t frame) noexcept;
+
+	// textures the pixels of every triangle drawn to the frame since the last call, see SetVisibilityBuffer
+	void ResolveVisibility(size_t frame) noexcept;
+
+	// raster stage of a frame: whatever the deferred draws queued, then the visibility resolve and Present
+	void RasterizeFrame(size_t frame) noexcept;
+
+	// fence of SetFrameLatency, returns once the frame in the background (if any) is presented
+	void WaitForRasterStage() noexcept;
 
 private:
 	// Utility
@@ -81,260 +276,462 @@ private:
 
 private:
 
-	// Content Window
-	std::unique_ptr<Platform::Window> m_windowContext = {nullptr};
+	// Where the frames go, a window or nothing at all
+	std::unique_ptr<Platform::Backend> m_backend = {nullptr};
 
 	// Buffers
 	uint32_t* m_accumulationBuffer = nullptr;
 	Color* m_backBuffers[BACKBUFFERCOUNT] = { nullptr };
+	bool m_backendBackBuffers[BACKBUFFERCOUNT] = { false }; // made by Backend::CreateBackBuffer, not the Allocator
 	unsigned char* m_alphaChannel[BACKBUFFERCOUNT] = { nullptr };
-	unsigned short* m_depthBuffer = nullptr;
+	// one depth buffer per back buffer, so a frame can be drawn while the previous one is still being rasterized
+	unsigned short* m_depthBuffer[BACKBUFFERCOUNT] = { nullptr };
+	unsigned short* m_hiZBlocks[BACKBUFFERCOUNT] = { nullptr }; // farthest depth per block, see RenderTarget
+	unsigned short* m_hiZTiles[BACKBUFFERCOUNT] = { nullptr };
 	
 	size_t presentBufferIndex = 0;
 	size_t presentSampleIndex = 1;
+	size_t m_lastSampleIndex = 1; // of the last ClearScreen, the accumulation buffer is cleared when it goes down
+	std::atomic<float> m_presentTime = 0.0f; // see PresentTime, written by the raster stage
+
+	// Tiled rasterization
+	std::unique_ptr<ThreadPool> m_threadPool = { nullptr };
+	bool m_renderThreadsSet = false; // by SetRenderThreads, otherwise Start picks one per hardware thread after OnInit
+	std::vector<RasterTriangle> m_rasterTriangles[BACKBUFFERCOUNT];
+	std::vector<RasterTriangle> m_wireframeTriangles[BACKBUFFERCOUNT]; // of the deferred draws, drawn over the rest
+	std::vector<std::vector<uint32_t>> m_tileBins[BACKBUFFERCOUNT]; // triangle indices per tile, in submission order
+	std::vector<uint32_t> m_activeTiles[BACKBUFFERCOUNT];
+	GeometryContext m_geometry; // of the immediate draws
+	std::vector<GeometryContext> m_workerGeometry; // one per render thread
+	OcclusionBuffer m_occlusionBuffer;
+	size_t tilesX = 0;
+	size_t tilesY = 0;
+
+	// Deferred draws, the triangles of every command are kept apart so they're rasterized in the sorted order whichever thread made them
+	std::vector<DrawCommand> m_commands;
+	std::vector<uint32_t> m_commandOrder;
+	std::vector<std::vector<RasterTriangle>> m_commandTriangles;
+
+	// Visibility buffer, the triangles of the whole frame are kept until it's resolved and the ids index them
+	std::vector<uint32_t> m_visibilityIds[BACKBUFFERCOUNT];
+	std::vector<RasterTriangle> m_visibleTriangles[BACKBUFFERCOUNT];
+
+	// see StartCapture, fed by Present
+	std::unique_ptr<FrameCapture> m_capture = { nullptr };
+	std::unique_ptr<FrameStream> m_stream = { nullptr }; // see StartStream, same
+
+	// raster stage running in the background, see SetFrameLatency
+	std::future<void> m_rasterStage;
+	size_t m_frameLatency = 0;
+
+	// Simulation thread, the scene and input are its own and only copies of the scene are shared, see SetSimulationRate
+	std::jthread m_simulationThread;
+	float m_simulationRate = 0.0f; // what SetSimulationRate asked for, the thread only runs while m_looping
+	bool m_looping = false;
+	SceneSnapshot m_simulationScene;
+	Platform::InputState m_simulationInput;
+	TripleBuffer<SceneSnapshot> m_snapshots;
+
+	// clip space scale of the x and y clipping planes, 1 means clipping at the screen edges
+	float m_guardBandX = 1.0f;
+	float m_guardBandY = 1.0f;
+
+	// counted while drawing, moved to m_lastFrameStats once the frame's geometry stage is over, before it's rasterized
+	CullingStats m_frameStats;
+	CullingStats m_lastFrameStats;
 
 	// configurations
 	bool m_clearScreen = true;
 	bool m_InvertYaxis = false;
+	bool m_guardBand = true;
+	bool m_visibilityBuffer = false;
 };
 
 // could hide it away in the .cpp file, but have to lose the templated vertex and implement the same thing that DX12 does with D3D12_INPUT_ELEMENT_DESC + compiling and dlls
 template <minVertex vertexType>
 void Application::Draw3DObject(const Object3D<vertexType>& object, const Camera& camera, bool wireframe) noexcept
 {
-	const Matrix4x4f world = SRT
+	ProcessObject(object, camera, m_geometry, m_frameStats, true, [this, wireframe](const RasterTriangle& triangle) noexcept
+		{
+			if (!wireframe)
+			{
+				m_rasterTriangles[presentBufferIndex].push_back(triangle);
+			}
+			else
+			{
+				DrawTriangle(triangle, presentBufferIndex);
+			}
+		});
+
+	FlushTriangles(presentBufferIndex);
+}
+
+template <minVertex vertexType>
+void Application::Draw3DObjectInstanced(const Object3D<vertexType>& object, const Camera& camera, const Matrix4x4f* instances, size_t instanceCount, bool wireframe) noexcept
+{
+	const auto emit = [this, wireframe](const RasterTriangle& triangle) noexcept
+		{
+			if (!wireframe)
+			{
+				m_rasterTriangles[presentBufferIndex].push_back(triangle);
+			}
+			else
+			{
+				DrawTriangle(triangle, presentBufferIndex);
+			}
+		};
+
+	// flushing between batches keeps the queued triangles from growing with the instance count
+	for (size_t first = 0; first < instanceCount; first += INSTANCE_BATCH)
+	{
+		ProcessInstances(object, camera, instances + first, std::min(INSTANCE_BATCH, instanceCount - first), m_geometry, m_frameStats, true, emit);
+		FlushTriangles(presentBufferIndex);
+	}
+}
+
+template <minVertex vertexType>
+void Application::Submit3DObject(const Object3D<vertexType>& object, const Camera& camera, bool wireframe) noexcept
+{
+	DrawCommand& command = m_commands.emplace_back();
+	command.object = &object;
+	command.camera = camera;
+	command.wireframe = wireframe;
+	command.texture = object.diffuseTextures.size() > 0 ? &object.diffuseTextures[0] : nullptr;
+	command.process = &ProcessCommand<vertexType>;
+	command.world = SRT
 	(
 		Scale(object.scale.x, object.scale.y, object.scale.z),
 		Rotate(object.rotation.z, object.rotation.y, object.rotation.x),
 		Translate(object.positionInSpace.x, object.positionInSpace.y, object.positionInSpace.z)
 	);
-	const Matrix4x4f worldView = world * camera.lastCameraMatrix;
-	const Matrix4x4f projectionViewPort = ProjectionMatrix(
-		(uint16_t)canvasWidth,
-		(uint16_t)canvasHeight,
-		camera.projection.fieldOfView,
-		camera.projection.nearPlane,
-		camera.projection.farPlane) * VPMatrix;
 
-	const float canvasH = static_cast<float>(canvasHeight - 1);
-	const float canvasW = static_cast<float>(canvasWidth - 1);
-
-	for (size_t i = 0; i < object.meshArr.size(); i++)
+	// the center of its boxes when it has them, its origin otherwise
+	Vec3f center = { 0.0f, 0.0f, 0.0f };
+	if (object.collisionBoxes.size() > 0)
 	{
-		const Mesh<vertexType>& mesh = object.meshArr[i];
-		for (size_t j = 0; j < mesh.indices.size(); j += 3) // 3 vertices make a triangle
+		AABB bounds = object.collisionBoxes[0];
+		for (size_t i = 1; i < object.collisionBoxes.size(); i++)
 		{
-			Triangle<vertexType> toWorld{ mesh.vertices[mesh.indices[j]], mesh.vertices[mesh.indices[j + 1]], mesh.vertices[mesh.indices[j + 2]] };
-			toWorld *= world;
+			bounds = Merge(bounds, object.collisionBoxes[i]);
+		}
+		center = (bounds.min + bounds.max) * 0.5f;
+	}
 
-			const Vec3f normal = normalize(cross(toWorld.b.position - toWorld.a.position, toWorld.c.position - toWorld.a.position));
+	// through the same batch transform as the vertices, a single point of it. The view matrix leaves w at 1
+	float x, y, z, w;
+	uint8_t outcode;
+	TransformPoints(command.world * camera.lastCameraMatrix, &center.x, &center.y, &center.z, 1, &x, &y, &z, &w, &outcode);
+	command.depth = z;
+}
 
-			// If ray is aligned with normal, then triangle is visible
-			if (dot(normal, toWorld.a.position - camera.position) < 0.0f)
-			{
-				// world to View, clip against near plane
-				ClippedTriangle<vertexType> nearClipped = ClipAgainstPlane<vertexType>({ 0.0f, 0.0f, camera.projection.nearPlane }, { 0.0f, 0.0f, 1.0f }, toWorld * camera.lastCameraMatrix);
+template <minVertex vertexType>
+void Application::ProcessCommand(const Application& app, const DrawCommand& command, GeometryContext& context, CullingStats& stats, std::vector<RasterTriangle>& triangles) noexcept
+{
+	const Object3D<vertexType>& object = *static_cast<const Object3D<vertexType>*>(command.object);
 
-				std::array<Triangle<vertexType>, 16> tArray;
-				size_t triangleCount = 0;
+	app.ProcessInstances(object, command.camera, &command.world, 1, context, stats, true, [&triangles](const RasterTriangle& triangle) noexcept
+		{
+			triangles.push_back(triangle);
+		});
+}
 
-				for (size_t n = 0; n < nearClipped.num; n++)
-				{
-					// clip against far plane
-					const ClippedTriangle<vertexType> farClipped = ClipAgainstPlane<vertexType>({ 0.0f, 0.0f, camera.projection.farPlane }, { 0.0f, 0.0f, -1.0f }, nearClipped.triangles[n]);
+template <minVertex vertexType>
+void Application::DrawOccluder(const Object3D<vertexType>& object, const Camera& camera) noexcept
+{
+	// occluders aren't what the stats are about
+	CullingStats ignored;
 
-					for (size_t m = 0; m < farClipped.num; m++)
-					{
-						// apply projection and scale to view port
-						tArray[triangleCount++] = farClipped.triangles[m] * projectionViewPort;
-					}
-				}
+	ProcessObject(object, camera, m_geometry, ignored, false, [this](const RasterTriangle& triangle) noexcept
+		{
+			m_occlusionBuffer.Rasterize(triangle);
+		});
+}
 
-				size_t newTriangles = triangleCount;
+template <minVertex vertexType, typename Emit>
+void Application::ProcessObject(const Object3D<vertexType>& object, const Camera& camera, GeometryContext& context, CullingStats& stats, bool testOcclusion, Emit&& emit) const noexcept
+{
+	const Matrix4x4f world = SRT
+	(
+		Scale(object.scale.x, object.scale.y, object.scale.z),
+		Rotate(object.rotation.z, object.rotation.y, object.rotation.x),
+		Translate(object.positionInSpace.x, object.positionInSpace.y, object.positionInSpace.z)
+	);
 
-				for (size_t p = 0; p < 4; p++)
-				{
-					size_t arrayIterator = 0;
-					size_t newCount = 0;
+	ProcessInstances(object, camera, &world, 1, context, stats, testOcclusion, std::forward<Emit>(emit));
+}
 
-					while (newTriangles-- > 0)
-					{
-						const Triangle<vertexType>& front = tArray[arrayIterator++];
+template <minVertex vertexType, typename Emit>
+void Application::ProcessInstances(const Object3D<vertexType>& object, const Camera& camera, const Matrix4x4f* worlds, size_t instanceCount, GeometryContext& context, CullingStats& stats, bool testOcclusion, Emit&& emit) const noexcept
+{
+	const Matrix4x4f projection = ProjectionMatrix(
+		(uint16_t)canvasWidth,
+		(uint16_t)canvasHeight,
+		camera.projection.fieldOfView,
+		camera.projection.nearPlane,
+		camera.projection.farPlane);
 
-						ClippedTriangle<vertexType> planeRes;
+	// Perspective divide and view port mapping of the vertices the clipper creates, 1/w is kept for perspective correct texturing.
+	// The mesh's own vertices are already projected in the vertex cache, see ProjectPoints
+	const auto toRaster = [this](const ClipVertex& v) noexcept -> RasterVertex
+		{
+			const float invW = 1.0f / v.position.w;
+			return
+			{
+				v.position.x * invW * VPMatrix.rc[0][0] + VPMatrix.rc[3][0],
+				v.position.y * invW * VPMatrix.rc[1][1] + VPMatrix.rc[3][1],
+				v.position.z * invW * VPMatrix.rc[2][2] + VPMatrix.rc[3][2],
+				invW, v.uv.x, v.uv.y
+			};
+		};
 
-						// clip against every other plane
-						switch (p)
-						{
-							case 0: planeRes = ClipAgainstPlane<vertexType>({ 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, front); break;
-							case 1: planeRes = ClipAgainstPlane<vertexType>({ 0.0f, canvasH, 0.0f }, { 0.0f, -1.0f, 0.0f }, front); break;
-							case 2: planeRes = ClipAgainstPlane<vertexType>({ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, front); break;
-							case 3: planeRes = ClipAgainstPlane<vertexType>({ canvasW, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, front); break;
-						}
+	// the loader gives every mesh a box, objects built by hand may not have them and are simply never culled
+	const bool hasBounds = object.collisionBoxes.size() == object.meshArr.size() && object.meshArr.size() > 0;
 
-						for (size_t n = 0; n < planeRes.num; n++)
-						{
-							tArray[newCount++] = planeRes.triangles[n];
-						}
-					}
+	AABB bounds = {};
+	if (hasBounds)
+	{
+		bounds = object.collisionBoxes[0];
+		for (size_t i = 1; i < object.collisionBoxes.size(); i++)
+		{
+			bounds = Merge(bounds, object.collisionBoxes[i]);
+		}
+	}
 
-					arrayIterator = 0;
-					triangleCount = newCount;
-					newTriangles = newCount;
-				}
+	context.instanceMatrices.clear();
+	for (size_t k = 0; k < instanceCount; k++)
+	{
+		const Matrix4x4f worldViewProjection = worlds[k] * camera.lastCameraMatrix * projection;
 
-				// Finally draw it
-				if (!wireframe)
-				{
-					for (size_t t = 0; t < triangleCount; t++)
-					{
-						DrawTexturedTriangle(tArray[t], object.diffuseTextures[i]);
-					}
-				}
-				else
-				{
-					for (size_t t = 0; t < triangleCount; t++)
-					{
-						DrawTriangle(tArray[t]);
-					}
-				}
+		if (hasBounds)
+		{
+			stats.objectsTested++;
+			if (ClassifyAABB(bounds, worldViewProjection).all != 0)
+			{
+				stats.objectsCulled++;
+				continue;
+			}
+
+			if (testOcclusion && m_occlusionBuffer.IsOccluded(bounds, worldViewProjection))
+			{
+				stats.objectsOccluded++;
+				continue;
 			}
 		}
+
+		context.instanceMatrices.push_back(worldViewProjection);
 	}
-}
 
-template <minVertex vertexType>
-void Application::DrawTriangle(const Triangle<vertexType>& triangle) noexcept
-{
-	DrawLine(triangle.a.position, triangle.b.position, { (unsigned char)255, (unsigned char)255, (unsigned char)255 });
-	DrawLine(triangle.b.position, triangle.c.position, { (unsigned char)255, (unsigned char)255, (unsigned char)255 });
-	DrawLine(triangle.c.position, triangle.a.position, { (unsigned char)255, (unsigned char)255, (unsigned char)255 });
-}
+	if (context.instanceMatrices.empty())
+	{
+		return;
+	}
 
-template <minVertex vertexType>
-void Application::DrawTexturedTriangle(const Triangle<vertexType>& triangle, const Image& texture) noexcept
-{
-	using namespace std;
-	using depthBufferType = remove_pointer_t<decltype(m_depthBuffer)>;
+	for (size_t i = 0; i < object.meshArr.size(); i++)
+	{
+		const Mesh<vertexType>& fullMesh = object.meshArr[i];
 
-	static const float max = static_cast<float>(numeric_limits<depthBufferType>::max());
+		// levels are picked from the projected size of the mesh box, so objects built by hand without boxes always draw in full
+		context.instanceLevels.assign(context.instanceMatrices.size(), 0);
+		uint32_t usedLevels = 0;
 
-	auto drawPixel = [&](uint16_t x, uint16_t y, float u, float v, float z) noexcept -> void
+		for (size_t k = 0; k < context.instanceMatrices.size(); k++)
 		{
-			const size_t index = static_cast<size_t>(y) * canvasWidth + x;
-			depthBufferType Zvalue = static_cast<depthBufferType>(abs(z * max));
+			const Matrix4x4f& worldViewProjection = context.instanceMatrices[k];
 
-			if (m_depthBuffer[index] > Zvalue)
+			// with a single mesh its box is the object's one, which was just tested
+			if (hasBounds && object.meshArr.size() > 1)
 			{
-				m_depthBuffer[index] = Zvalue;
-				const Color rgb = texture.sample(u, v);
-				memcpy(&m_backBuffers[presentBufferIndex][index], &rgb, sizeof(Color));
+				stats.meshesTested++;
+				if (ClassifyAABB(object.collisionBoxes[i], worldViewProjection).all != 0)
+				{
+					stats.meshesCulled++;
+					context.instanceLevels[k] = CULLED_LEVEL;
+					continue;
+				}
 			}
-		};
 
-	// Bring data to the stack
-	int32_t x1 = static_cast<int32_t>(triangle.a.position.x + 0.5f);
-	int32_t x2 = static_cast<int32_t>(triangle.b.position.x + 0.5f);
-	int32_t x3 = static_cast<int32_t>(triangle.c.position.x + 0.5f);
-	int32_t y1 = static_cast<int32_t>(triangle.a.position.y + 0.5f);
-	int32_t y2 = static_cast<int32_t>(triangle.b.position.y + 0.5f);
-	int32_t y3 = static_cast<int32_t>(triangle.c.position.y + 0.5f);
-
-	float z1_inv = 1.0f / triangle.a.position.z;
-	float z2_inv = 1.0f / triangle.b.position.z;
-	float z3_inv = 1.0f / triangle.c.position.z;
-
-	float u1 = triangle.a.uv.x * z1_inv;
-	float u2 = triangle.b.uv.x * z2_inv;
-	float u3 = triangle.c.uv.x * z3_inv;
-	float v1 = triangle.a.uv.y * z1_inv;
-	float v2 = triangle.b.uv.y * z2_inv;
-	float v3 = triangle.c.uv.y * z3_inv;
-
-	// Sort by Y axis
-	if (y1 > y2) { swap(y1, y2); swap(x1, x2); swap(u1, u2); swap(v1, v2); swap(z1_inv, z2_inv); }
-	if (y1 > y3) { swap(y1, y3); swap(x1, x3); swap(u1, u3); swap(v1, v3); swap(z1_inv, z3_inv); }
-	if (y2 > y3) { swap(y2, y3); swap(x2, x3); swap(u2, u3); swap(v2, v3); swap(z2_inv, z3_inv); }
-
-	int dy1 = y2 - y1, dx1 = x2 - x1;
-	int dy2 = y3 - y1, dx2 = x3 - x1;
-	float du1 = u2 - u1, dv1 = v2 - v1, dz1 = z2_inv - z1_inv;
-	float du2 = u3 - u1, dv2 = v3 - v1, dz2 = z3_inv - z1_inv;
-
-	float dax_step = (dy1 != 0) ? static_cast<float>(dx1) / abs(dy1) : 0;
-	float dbx_step = (dy2 != 0) ? static_cast<float>(dx2) / abs(dy2) : 0;
-	float du1_step = (dy1 != 0) ? du1 / abs(dy1) : 0;
-	float dv1_step = (dy1 != 0) ? dv1 / abs(dy1) : 0;
-	float dz1_step = (dy1 != 0) ? dz1 / abs(dy1) : 0;
-	float du2_step = (dy2 != 0) ? du2 / abs(dy2) : 0;
-	float dv2_step = (dy2 != 0) ? dv2 / abs(dy2) : 0;
-	float dz2_step = (dy2 != 0) ? dz2 / abs(dy2) : 0;
-
-	auto drawScanline = [&](int y, int ax, int bx, float su, float eu, float sv, float ev, float sz, float ez) noexcept -> void
-		{
-			if (ax > bx)
+			if (hasBounds && fullMesh.lods.size() > 0)
 			{
-				swap(ax, bx);
-				swap(su, eu);
-				swap(sv, ev);
-				swap(sz, ez);
+				const Vec2f extent = ProjectedExtent(object.collisionBoxes[i], worldViewProjection);
+				const float screenSize = std::max(extent.x * 0.5f * canvasWidth, extent.y * 0.5f * canvasHeight);
+				context.instanceLevels[k] = static_cast<uint8_t>(object.SelectLOD(i, screenSize));
 			}
 
-			const int width = bx - ax;
-			if (width == 0)
+			usedLevels |= 1u << context.instanceLevels[k];
+		}
+
+		for (size_t level = 0; level <= fullMesh.lods.size(); level++)
+		{
+			if ((usedLevels & (1u << level)) == 0)
 			{
-				return;
+				continue;
 			}
 
-			const float tstep = 1.0f / width;
-			float t = 0.0f;
+			const Mesh<vertexType>& mesh = level == 0 ? fullMesh : fullMesh.lods[level - 1];
 
-			for (int x = ax; x < bx; ++x, t += tstep)
+			// Interleaved vertices are read once, every instance drawing this level transforms the same staged positions.
+			// Streamed ones are transformed right where they are
+			const bool streamed = mesh.streams.Size() > 0;
+			if (!streamed)
 			{
-				const float u = su + t * (eu - su);
-				const float v = sv + t * (ev - sv);
-				const float z = sz + t * (ez - sz);
-
-				drawPixel((uint16_t)x, (uint16_t)y, u / z, v / z, 1.0f / z);
+				StagePositions(mesh.vertices, context.vertexCache.positions);
 			}
-		};
 
-	// Upper part
-	for (int y = y1; y <= y2; ++y)
-	{
-		const int ax = x1 + static_cast<int>((y - y1) * dax_step);
-		const int bx = x1 + static_cast<int>((y - y1) * dbx_step);
-		const float su = u1 + (y - y1) * du1_step;
-		const float eu = u1 + (y - y1) * du2_step;
-		const float sv = v1 + (y - y1) * dv1_step;
-		const float ev = v1 + (y - y1) * dv2_step;
-		const float sz = z1_inv + (y - y1) * dz1_step;
-		const float ez = z1_inv + (y - y1) * dz2_step;
-
-		drawScanline(y, ax, bx, su, eu, sv, ev, sz, ez);
-	}
+			for (size_t k = 0; k < context.instanceMatrices.size(); k++)
+			{
+				if (context.instanceLevels[k] != level)
+				{
+					continue;
+				}
 
-	dy1 = y3 - y2, dx1 = x3 - x2;
-	du1 = u3 - u2, dv1 = v3 - v2, dz1 = z3_inv - z2_inv;
+				const Matrix4x4f& worldViewProjection = context.instanceMatrices[k];
 
-	dax_step = (dy1 != 0) ? static_cast<float>(dx1) / abs(dy1) : 0;
-	du1_step = (dy1 != 0) ? du1 / abs(dy1) : 0;
-	dv1_step = (dy1 != 0) ? dv1 / abs(dy1) : 0;
-	dz1_step = (dy1 != 0) ? dz1 / abs(dy1) : 0;
+				// whole meshlets off screen, facing away or hidden go before a single vertex is transformed,
+				// a mesh without any is a single run of triangles
+				Meshlet wholeMesh;
+				wholeMesh.indexCount = static_cast<uint32_t>(mesh.IndexCount());
 
-	// Lower part
-	for (int y = y2; y <= y3; ++y)
-	{
-		const int ax = x2 + static_cast<int>((y - y2) * dax_step);
-		const int bx = x1 + static_cast<int>((y - y1) * dbx_step);
-		const float su = u2 + (y - y2) * du1_step;
-		const float eu = u1 + (y - y1) * du2_step;
-		const float sv = v2 + (y - y2) * dv1_step;
-		const float ev = v1 + (y - y1) * dv2_step;
-		const float sz = z2_inv + (y - y2) * dz1_step;
-		const float ez = z1_inv + (y - y1) * dz2_step;
-
-		drawScanline(y, ax, bx, su, eu, sv, ev, sz, ez);
+				context.visibleMeshlets.clear();
+				if (mesh.meshlets.size() > 0)
+				{
+					const MeshletFrustum frustum = MakeMeshletFrustum(worldViewProjection);
+					const bool occlusion = testOcclusion && m_occlusionBuffer.HasOccluders();
+
+					for (size_t m = 0; m < mesh.meshlets.size(); m++)
+					{
+						const Meshlet& meshlet = mesh.meshlets[m];
+						stats.meshletsTested++;
+
+						const Vec3f extent = { meshlet.radius, meshlet.radius, meshlet.radius };
+						if (!IsMeshletVisible(meshlet, frustum) || (occlusion && m_occlusionBuffer.IsOccluded({ meshlet.center - extent, meshlet.center + extent }, worldViewProjection)))
+						{
+							stats.meshletsCulled++;
+							continue;
+						}
+
+						context.visibleMeshlets.push_back(&meshlet);
+					}
+
+					if (context.visibleMeshlets.empty())
+					{
+						continue;
+					}
+				}
+				else
+				{
+					context.visibleMeshlets.push_back(&wholeMesh);
+				}
+
+				// transform every vertex once, shared vertices are then simply looked up by the triangles using them.
+				// Quantized positions are staged as they are stored, bringing them back to model space is folded into the matrix
+				Matrix4x4f vertexToClip = worldViewProjection;
+				if constexpr (quantizedVertex<vertexType>)
+				{
+					vertexToClip = mesh.Dequantization() * worldViewProjection;
+				}
+
+				if (streamed)
+				{
+					TransformPoints(vertexToClip, &mesh.streams.x[0], &mesh.streams.y[0], &mesh.streams.z[0], mesh.streams.Size(), context.vertexCache.clip);
+				}
+				else
+				{
+					TransformPoints(vertexToClip, context.vertexCache.positions, context.vertexCache.clip);
+				}
+				ProjectPoints(VPMatrix, context.vertexCache.clip, context.vertexCache.screen);
+
+				const std::vector<uint8_t>& outcodes = context.vertexCache.clip.outcode;
+
+				// the triangles read their indices at the width the mesh has and their uvs from wherever the layout keeps them,
+				// both decided once per mesh instead of on every index
+				const auto assemble = [&](const auto* indices, const auto& uvAt) noexcept
+				{
+					for (const Meshlet* meshlet : context.visibleMeshlets)
+					{
+						for (size_t j = meshlet->firstIndex; j < meshlet->firstIndex + meshlet->indexCount; j += 3) // 3 vertices make a triangle
+						{
+							const uint32_t ia = indices[j];
+							const uint32_t ib = indices[j + 1];
+							const uint32_t ic = indices[j + 2];
+
+							stats.trianglesTested++;
+
+							// every vertex is outside of the same plane, nothing to draw
+							if ((outcodes[ia] & outcodes[ib] & outcodes[ic]) != 0)
+							{
+								stats.trianglesCulled++;
+								continue;
+							}
+
+							const Vec4f A = context.vertexCache.clip.At(ia);
+							const Vec4f B = context.vertexCache.clip.At(ib);
+							const Vec4f C = context.vertexCache.clip.At(ic);
+
+							// the sign of the homogeneous (x, y, w) determinant is the winding on screen, and unlike the projected
+							// area it still holds for triangles crossing the camera plane, so back faces go away before any clipping
+							if (IsBackFacing(A, B, C))
+							{
+								stats.trianglesCulled++;
+								continue;
+							}
+
+							ClipPolygon& polygon = context.clipPolygon;
+							polygon.pool[0] = { A, uvAt(ia) };
+							polygon.pool[1] = { B, uvAt(ib) };
+							polygon.pool[2] = { C, uvAt(ic) };
+
+							// vertices all inside of the frustum go straight through, only the planes some vertex is out of are clipped against.
+							// With a guard band the sides only matter once a vertex is past the band, the rasterizer scissors anything closer
+							uint8_t planes = outcodes[ia] | outcodes[ib] | outcodes[ic];
+							if ((planes & OUTCODE_SIDES) != 0 && m_guardBandX > 1.0f)
+							{
+								const uint8_t guardCodes = ComputeOutcode(A, m_guardBandX, m_guardBandY) | ComputeOutcode(B, m_guardBandX, m_guardBandY) | ComputeOutcode(C, m_guardBandX, m_guardBandY);
+								planes = static_cast<uint8_t>((planes & ~OUTCODE_SIDES) | (guardCodes & OUTCODE_SIDES));
+							}
+
+							const uint32_t count = ClipTriangle(polygon, planes, m_guardBandX, m_guardBandY);
+
+							// the triangle's own corners are the first three of the pool, only the ones the clipper made still need projecting
+							const uint32_t corners[3] = { ia, ib, ic };
+							const ScreenStreams& screen = context.vertexCache.screen;
+
+							RasterVertex projected[ClipPolygon::MAX_VERTICES];
+							for (uint32_t v = 0; v < count; v++)
+							{
+								const uint8_t p = polygon.indices[v];
+								if (p < 3)
+								{
+									const uint32_t c = corners[p];
+									projected[v] = { screen.x[c], screen.y[c], screen.z[c], screen.invW[c], polygon.pool[p].uv.x, polygon.pool[p].uv.y };
+								}
+								else
+								{
+									projected[v] = toRaster(polygon.pool[p]);
+								}
+							}
+
+							// the clipped polygon is convex, so it's emitted as a fan
+							for (uint32_t v = 1; v + 1 < count; v++)
+							{
+								emit(RasterTriangle{ projected[0], projected[v], projected[v + 1], &object.diffuseTextures[i] });
+							}
+						}
+					}
+				};
+
+				mesh.VisitIndices([&](const auto* indices) noexcept
+					{
+						if (streamed)
+						{
+							assemble(indices, [&mesh](uint32_t v) noexcept { return Vec2f{ mesh.streams.u[v], mesh.streams.v[v] }; });
+						}
+						else
+						{
+							assemble(indices, [&mesh](uint32_t v) noexcept -> Vec2f { return mesh.vertices[v].uv; });
+						}
+					});
+			}
+		}
 	}
 }
 
@@ -0,0 +1,335 @@
+#include "Reorder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	// a cluster only gets split further while the pieces stay within this much of its own cache efficiency
+	constexpr float SPLIT_THRESHOLD = 1.05f;
+
+	// Vertices are in the cache while fewer than REORDER_CACHE_SIZE misses happened since they were last loaded,
+	// which is a first in first out cache counted with timestamps instead of a queue
+	struct CacheSimulation
+	{
+		std::vector<size_t> loadedAt;
+		size_t time = REORDER_CACHE_SIZE + 1;
+
+		explicit CacheSimulation(size_t vertexCount) : loadedAt(vertexCount, 0) {}
+
+		bool Contains(uint32_t vertex) const noexcept
+		{
+			return time - loadedAt[vertex] <= REORDER_CACHE_SIZE;
+		}
+
+		// 1 when the vertex had to be loaded
+		size_t Use(uint32_t vertex) noexcept
+		{
+			if (Contains(vertex))
+			{
+				return 0;
+			}
+
+			loadedAt[vertex] = time++;
+			return 1;
+		}
+
+		void Flush() noexcept
+		{
+			time += REORDER_CACHE_SIZE + 1;
+		}
+	};
+
+	// Tipsify, the triangles in their new order
+	std::vector<uint32_t> Tipsify(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		const size_t triangleCount = indexCount / 3;
+
+		// triangles around every vertex, packed
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			offsets[indices[i] + 1]++;
+		}
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// triangles not emitted yet around every vertex
+		std::vector<uint32_t> live(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			live[i] = offsets[i + 1] - offsets[i];
+		}
+
+		CacheSimulation cache(vertexCount);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnds; // recently used vertices, where to continue from once the neighbourhood runs out
+		std::vector<uint32_t> candidates;
+		size_t scan = 0; // vertices below have nothing left
+
+		std::vector<uint32_t> triangles;
+		triangles.reserve(triangleCount);
+
+		int64_t fan = triangleCount > 0 ? static_cast<int64_t>(indices[0]) : -1;
+
+		while (fan >= 0)
+		{
+			candidates.clear();
+
+			for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+			{
+				const uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				for (size_t v = 0; v < 3; v++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + v];
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					cache.Use(vertex);
+				}
+
+				emitted[triangle] = 1;
+				triangles.push_back(triangle);
+			}
+
+			// the oldest candidate that still is in the cache after fanning all of its triangles, if any is
+			int64_t next = -1;
+			size_t bestPriority = 0;
+			for (const uint32_t vertex : candidates)
+			{
+				if (live[vertex] == 0)
+				{
+					continue;
+				}
+
+				size_t priority = 0;
+				const size_t age = cache.time - cache.loadedAt[vertex];
+				if (age + 2 * live[vertex] <= REORDER_CACHE_SIZE)
+				{
+					priority = age;
+				}
+
+				if (priority > bestPriority)
+				{
+					next = vertex;
+					bestPriority = priority;
+				}
+			}
+
+			if (next >= 0)
+			{
+				fan = next;
+				continue;
+			}
+
+			// dead end, back to a vertex used lately or the first one with triangles left
+			while (!deadEnds.empty() && next < 0)
+			{
+				const uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				next = live[vertex] > 0 ? static_cast<int64_t>(vertex) : -1;
+			}
+
+			while (next < 0 && scan < vertexCount)
+			{
+				if (live[scan] > 0)
+				{
+					next = static_cast<int64_t>(scan);
+				}
+				scan++;
+			}
+
+			fan = next;
+		}
+
+		return triangles;
+	}
+}
+
+std::vector<uint32_t> OptimizeTriangleOrder(const Vec3f* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+
+	const std::vector<uint32_t> triangles = Tipsify(indices, indexCount, vertexCount);
+
+	// hard clusters start at the triangles with nothing left in the cache, where Tipsify had to jump
+	std::vector<size_t> boundaries;
+	CacheSimulation cache(vertexCount);
+
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		size_t misses = 0;
+		for (size_t v = 0; v < 3; v++)
+		{
+			misses += cache.Use(indices[triangles[t] * 3 + v]);
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			boundaries.push_back(t);
+		}
+	}
+
+	// Every hard cluster is split wherever the triangles since the last split reuse vertices about as well as the whole
+	// cluster does, more clusters give the sort below more to work with for very little cache efficiency
+	std::vector<size_t> clusters;
+
+	for (size_t b = 0; b < boundaries.size(); b++)
+	{
+		const size_t begin = boundaries[b];
+		const size_t end = b + 1 < boundaries.size() ? boundaries[b + 1] : triangles.size();
+
+		if (begin == end)
+		{
+			continue;
+		}
+
+		cache.Flush();
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; t++)
+		{
+			for (size_t v = 0; v < 3; v++)
+			{
+				clusterMisses += cache.Use(indices[triangles[t] * 3 + v]);
+			}
+		}
+		const float threshold = SPLIT_THRESHOLD * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+		cache.Flush();
+		clusters.push_back(begin);
+		size_t start = begin;
+		size_t misses = 0;
+
+		for (size_t t = begin; t < end; t++)
+		{
+			for (size_t v = 0; v < 3; v++)
+			{
+				misses += cache.Use(indices[triangles[t] * 3 + v]);
+			}
+
+			if (t + 1 < end && static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= threshold)
+			{
+				clusters.push_back(t + 1);
+				start = t + 1;
+				misses = 0;
+				cache.Flush();
+			}
+		}
+	}
+
+	// Clusters further out along the way they face cover the rest from most points of view, they go first.
+	// Same facing as IsBackFacing, cross(b - a, c - a) points to the front
+	Vec3f meshCenter;
+	float meshArea = 0.0f;
+	std::vector<float> keys(clusters.size(), 0.0f);
+	std::vector<Vec3f> centers(clusters.size());
+	std::vector<Vec3f> normals(clusters.size());
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles.size();
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < end; t++)
+		{
+			const Vec3f& a = positions[indices[triangles[t] * 3]];
+			const Vec3f& b = positions[indices[triangles[t] * 3 + 1]];
+			const Vec3f& d = positions[indices[triangles[t] * 3 + 2]];
+
+			const Vec3f normal = cross(b - a, d - a);
+			const float triangleArea = std::sqrt(dot(normal, normal));
+
+			centers[c] += (a + b + d) * (triangleArea / 3.0f);
+			normals[c] += normal;
+			area += triangleArea;
+		}
+
+		meshCenter += centers[c];
+		meshArea += area;
+		centers[c] = area > 0.0f ? centers[c] / area : positions[indices[triangles[clusters[c]] * 3]];
+	}
+
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : Vec3f{};
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const float length = std::sqrt(dot(normals[c], normals[c]));
+		keys[c] = length > 0.0f ? dot(centers[c] - meshCenter, normals[c]) / length : 0.0f;
+	}
+
+	std::vector<uint32_t> clusterOrder(clusters.size());
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&keys](uint32_t l, uint32_t r) { return keys[l] > keys[r]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	for (const uint32_t c : clusterOrder)
+	{
+		const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles.size();
+		for (size_t t = clusters[c]; t < end; t++)
+		{
+			result.push_back(indices[triangles[t] * 3]);
+			result.push_back(indices[triangles[t] * 3 + 1]);
+			result.push_back(indices[triangles[t] * 3 + 2]);
+		}
+	}
+
+	return result;
+}
+
+std::vector<uint32_t> VertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == UINT32_MAX)
+		{
+			remap[indices[i]] = next++;
+		}
+	}
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (remap[i] == UINT32_MAX)
+		{
+			remap[i] = next++;
+		}
+	}
+
+	return remap;
+}
+
+float AverageCacheMissRatio(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	if (indexCount < 3)
+	{
+		return 0.0f;
+	}
+
+	CacheSimulation cache(vertexCount);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		misses += cache.Use(indices[i]);
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
@@ -0,0 +1,367 @@
+#include "Simplify.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	// Sum of squared distances to a set of planes as a symmetric 4x4 matrix, each plane weighted by the area it came from.
+	// Kept in double, the terms of a big mesh cancel out a lot when evaluated
+	struct Quadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+
+		// plane ax + by + cz + d = 0 with a unit normal
+		void AddPlane(double a, double b, double c, double d, double weight) noexcept
+		{
+			a2 += a * a * weight; ab += a * b * weight; ac += a * c * weight; ad += a * d * weight;
+			b2 += b * b * weight; bc += b * c * weight; bd += b * d * weight;
+			c2 += c * c * weight; cd += c * d * weight;
+			d2 += d * d * weight;
+		}
+
+		void Add(const Quadric& q) noexcept
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		double Error(const Vec3f& p) const noexcept
+		{
+			const double x = p.x, y = p.y, z = p.z;
+
+			return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+				 + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+				 + c2 * z * z + 2.0 * cd * z
+				 + d2;
+		}
+	};
+
+	enum class VertexKind : uint8_t
+	{
+		MANIFOLD, // free to collapse onto any neighbour
+		BORDER,   // on an open edge, only collapses along it
+		LOCKED    // shares its position with another vertex or sits on a non manifold edge, never moves
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	// open borders keep their shape with a plane through every border edge, perpendicular to its triangle, weighted this much heavier
+	constexpr double BORDER_WEIGHT = 10.0;
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b) noexcept
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	// vertices sharing exactly the same position get the same id, the lowest index among them
+	std::vector<uint32_t> PositionIds(const Vec3f* positions, size_t vertexCount)
+	{
+		struct PositionHash
+		{
+			size_t operator()(const Vec3f& p) const noexcept
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &p.x, sizeof(float));
+				std::memcpy(bits + 1, &p.y, sizeof(float));
+				std::memcpy(bits + 2, &p.z, sizeof(float));
+
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+		struct PositionEqual
+		{
+			bool operator()(const Vec3f& a, const Vec3f& b) const noexcept
+			{
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			}
+		};
+
+		std::unordered_map<Vec3f, uint32_t, PositionHash, PositionEqual> firstVertex;
+		firstVertex.reserve(vertexCount);
+
+		std::vector<uint32_t> ids(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			ids[i] = firstVertex.try_emplace(positions[i], i).first->second;
+		}
+
+		return ids;
+	}
+}
+
+std::vector<uint32_t> SimplifyIndices(const Vec3f* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount)
+{
+	std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+
+	if (result.size() <= targetIndexCount)
+	{
+		return result;
+	}
+
+	const std::vector<uint32_t> positionIds = PositionIds(positions, vertexCount);
+
+	// edges between positions rather than vertices, so the two sides of a UV seam still meet. Each one appears once in every
+	// direction on a closed surface, an edge without its twin is a border and one appearing twice in the same direction isn't manifold
+	std::unordered_map<uint64_t, uint32_t> directedEdges;
+	directedEdges.reserve(result.size());
+
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (size_t e = 0; e < 3; e++)
+		{
+			directedEdges[EdgeKey(positionIds[result[i + e]], positionIds[result[i + (e + 1) % 3]])]++;
+		}
+	}
+
+	std::vector<uint32_t> positionUses(vertexCount, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		positionUses[positionIds[i]]++;
+	}
+
+	std::vector<VertexKind> kinds(vertexCount, VertexKind::MANIFOLD);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (positionUses[positionIds[i]] > 1)
+		{
+			kinds[i] = VertexKind::LOCKED;
+		}
+	}
+
+	std::unordered_set<uint64_t> borderEdges;
+	std::vector<Quadric> quadrics(vertexCount);
+
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const Vec3f& p0 = positions[result[i]];
+		const Vec3f& p1 = positions[result[i + 1]];
+		const Vec3f& p2 = positions[result[i + 2]];
+
+		const Vec3f normal = cross(p1 - p0, p2 - p0);
+		const float length = std::sqrt(dot(normal, normal));
+
+		if (length == 0.0f)
+		{
+			continue;
+		}
+
+		const Vec3f n = { normal.x / length, normal.y / length, normal.z / length };
+		const double d = -dot(n, p0);
+
+		for (size_t v = 0; v < 3; v++)
+		{
+			quadrics[result[i + v]].AddPlane(n.x, n.y, n.z, d, length * 0.5);
+		}
+
+		for (size_t e = 0; e < 3; e++)
+		{
+			const uint32_t a = result[i + e];
+			const uint32_t b = result[i + (e + 1) % 3];
+			const uint32_t count = directedEdges[EdgeKey(positionIds[a], positionIds[b])];
+
+			if (count > 1)
+			{
+				kinds[a] = VertexKind::LOCKED;
+				kinds[b] = VertexKind::LOCKED;
+			}
+			else if (directedEdges.find(EdgeKey(positionIds[b], positionIds[a])) == directedEdges.end())
+			{
+				borderEdges.insert(EdgeKey(positionIds[a], positionIds[b]));
+				borderEdges.insert(EdgeKey(positionIds[b], positionIds[a]));
+
+				for (const uint32_t v : { a, b })
+				{
+					if (kinds[v] == VertexKind::MANIFOLD)
+					{
+						kinds[v] = VertexKind::BORDER;
+					}
+				}
+
+				const Vec3f edge = positions[b] - positions[a];
+				const Vec3f side = cross(edge, n);
+				const float sideLength = std::sqrt(dot(side, side));
+
+				if (sideLength > 0.0f)
+				{
+					const Vec3f s = { side.x / sideLength, side.y / sideLength, side.z / sideLength };
+					const double weight = dot(edge, edge) * BORDER_WEIGHT;
+
+					quadrics[a].AddPlane(s.x, s.y, s.z, -dot(s, positions[a]), weight);
+					quadrics[b].AddPlane(s.x, s.y, s.z, -dot(s, positions[a]), weight);
+				}
+			}
+		}
+	}
+
+	const auto canCollapse = [&](uint32_t from, uint32_t to) noexcept
+	{
+		switch (kinds[from])
+		{
+		case VertexKind::MANIFOLD:
+			return true;
+		case VertexKind::BORDER:
+			return kinds[to] != VertexKind::MANIFOLD && borderEdges.contains(EdgeKey(positionIds[from], positionIds[to]));
+		default:
+			return false;
+		}
+	};
+
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	std::vector<Collapse> collapses;
+
+	// Every pass collapses the cheapest edges that don't share a neighbourhood with one already taken, so they can't invalidate
+	// each other's checks, then the indices are remapped and the triangles that lost an edge are dropped
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triangleCount = result.size() / 3;
+
+		// triangles around every vertex, packed
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (const uint32_t index : result)
+		{
+			triangleOffsets[index + 1]++;
+		}
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			vertexTriangles[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t e = 0; e < 3; e++)
+			{
+				const uint32_t a = result[i + e];
+				const uint32_t b = result[i + (e + 1) % 3];
+
+				if (canCollapse(a, b))
+				{
+					collapses.push_back({ a, b, quadrics[a].Error(positions[b]) });
+				}
+				if (canCollapse(b, a))
+				{
+					collapses.push_back({ b, a, quadrics[b].Error(positions[a]) });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.error < r.error; });
+
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			remap[i] = i;
+		}
+		std::fill(touched.begin(), touched.end(), uint8_t(0));
+
+		const size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+		size_t removed = 0;
+		size_t applied = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// moving `from` mustn't turn any of its remaining triangles around
+			bool flips = false;
+			size_t lost = 0;
+
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++)
+			{
+				const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					lost++;
+					continue;
+				}
+
+				Vec3f before[3];
+				Vec3f after[3];
+				for (size_t v = 0; v < 3; v++)
+				{
+					before[v] = positions[triangle[v]];
+					after[v] = triangle[v] == collapse.from ? positions[collapse.to] : before[v];
+				}
+
+				const Vec3f nBefore = cross(before[1] - before[0], before[2] - before[0]);
+				const Vec3f nAfter = cross(after[1] - after[0], after[2] - after[0]);
+
+				// triangles that had no area to begin with have no side to flip to
+				flips = dot(nBefore, nAfter) <= 0.0f && dot(nBefore, nBefore) > 0.0f;
+			}
+
+			if (flips || lost == 0)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+
+			// the whole neighbourhood of `from` changed, nothing else around it collapses this pass
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+			{
+				const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+			}
+
+			applied++;
+			removed += lost;
+			if (removed >= trianglesToRemove)
+			{
+				break;
+			}
+		}
+
+		// nothing left that can collapse without breaking the mesh
+		if (applied == 0)
+		{
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const uint32_t a = remap[result[i]];
+			const uint32_t b = remap[result[i + 1]];
+			const uint32_t c = remap[result[i + 2]];
+
+			if (a != b && b != c && c != a)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	return result;
+}
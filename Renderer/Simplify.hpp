@@ -0,0 +1,103 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include "GeometricData.hpp"
+#include <algorithm>
+#include <vector>
+
+// most simplified levels a mesh gets, see GenerateLODs
+static constexpr size_t MAX_LODS = 4;
+
+// meshes (or levels) below this many triangles aren't simplified any further
+static constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+// Quadric error edge collapse (Garland & Heckbert) down to about targetIndexCount indices, fewer if it can't go that far.
+// A vertex only ever collapses onto one of its neighbours, so the result indexes the very same vertices.
+// Vertices sharing their position with another one (UV seams, hard edges) never move and the ones on an open border only move along it,
+// so the texturing and the outline of the mesh are kept
+std::vector<uint32_t> SimplifyIndices(const Vec3f* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount);
+
+// Fills mesh.lods with up to `levels` simplified copies of the mesh, each with about half the triangles of the previous one.
+// Every level only keeps the vertices it uses, memory comes from the Allocator. Stops early once a level barely gets any smaller
+template <minVertex vertexType>
+void GenerateLODs(Mesh<vertexType>& mesh, size_t levels) noexcept
+{
+	levels = std::min(levels, MAX_LODS);
+
+	if (levels == 0 || mesh.indices.size() < MIN_LOD_TRIANGLES * 3 * 2)
+	{
+		return;
+	}
+
+	std::vector<Vec3f> positions(mesh.vertices.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		positions[i] = mesh.ModelPosition(i);
+	}
+
+	std::vector<std::vector<uint32_t>> chain;
+	std::vector<uint32_t> source(&mesh.indices[0], &mesh.indices[0] + mesh.indices.size());
+
+	while (chain.size() < levels && source.size() >= MIN_LOD_TRIANGLES * 3 * 2)
+	{
+		const size_t target = (source.size() / 3 / 2) * 3;
+		std::vector<uint32_t> simplified = SimplifyIndices(positions.data(), positions.size(), source.data(), source.size(), target);
+
+		// a level that barely got smaller isn't worth its memory, the mesh is about as simple as it gets
+		if (simplified.empty() || simplified.size() * 100 > source.size() * 85)
+		{
+			break;
+		}
+
+		source = simplified;
+		chain.push_back(std::move(simplified));
+	}
+
+	if (chain.empty() || !mesh.lods.make_array(mesh.lods, chain.size()))
+	{
+		return;
+	}
+
+	// each level only keeps the vertices it uses, in order of first use which is also the order they're read in
+	std::vector<uint32_t> remap(mesh.vertices.size());
+	std::vector<uint32_t> used;
+
+	for (const std::vector<uint32_t>& lodIndices : chain)
+	{
+		std::fill(remap.begin(), remap.end(), UINT32_MAX);
+		used.clear();
+
+		for (const uint32_t index : lodIndices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				remap[index] = static_cast<uint32_t>(used.size());
+				used.push_back(index);
+			}
+		}
+
+		mesh.lods.emplace_back({}); // increase size()
+		Mesh<vertexType>& lod = mesh.lods[mesh.lods.size() - 1];
+		lod.positionScale = mesh.positionScale;
+		lod.positionOffset = mesh.positionOffset;
+
+		// out of memory, an empty level is never picked, see Object3D::SelectLOD
+		if (!lod.vertices.make_array(lod.vertices, used.size()) || !lod.indices.make_array(lod.indices, lodIndices.size()))
+		{
+			lod.vertices.destroy();
+			break;
+		}
+
+		for (const uint32_t index : used)
+		{
+			lod.vertices.emplace_back(mesh.vertices[index]);
+		}
+
+		for (const uint32_t index : lodIndices)
+		{
+			lod.indices.emplace_back(remap[index]);
+		}
+	}
+}
+
+#endif
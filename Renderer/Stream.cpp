@@ -0,0 +1,325 @@
+#include "Stream.hpp"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <immintrin.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+// BT.601 limited range, 8 bits of fraction
+static constexpr int32_t YR = 66, YG = 129, YB = 25;
+static constexpr int32_t UR = -38, UG = -74, UB = 112;
+static constexpr int32_t VR = 112, VG = -94, VB = -18;
+
+// chroma of the sums of 4 pixels, so 10 bits of fraction
+static inline uint8_t ChromaOf(int32_t r, int32_t g, int32_t b, int32_t cr, int32_t cg, int32_t cb) noexcept
+{
+	return static_cast<uint8_t>(((cr * r + cg * g + cb * b + 512) >> 10) + 128);
+}
+
+// 16 pixels of BGR, 48 bytes, as 16 bytes of each channel. mask[channel][part] takes the bytes of that channel out of the part-th 16 bytes
+static inline void Deinterleave(const uint8_t* bgr, const __m128i (&mask)[3][3], __m128i& b, __m128i& g, __m128i& r) noexcept
+{
+	const __m128i part0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr));
+	const __m128i part1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 16));
+	const __m128i part2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 32));
+
+	b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(part0, mask[0][0]), _mm_shuffle_epi8(part1, mask[0][1])), _mm_shuffle_epi8(part2, mask[0][2]));
+	g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(part0, mask[1][0]), _mm_shuffle_epi8(part1, mask[1][1])), _mm_shuffle_epi8(part2, mask[1][2]));
+	r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(part0, mask[2][0]), _mm_shuffle_epi8(part1, mask[2][1])), _mm_shuffle_epi8(part2, mask[2][2]));
+}
+
+// 16 luma values out of 16 bit channels
+static inline __m128i Luma(__m256i b, __m256i g, __m256i r) noexcept
+{
+	// at most 220 * 255 + 128, it fits unsigned 16 bits
+	__m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(YR)), _mm256_mullo_epi16(g, _mm256_set1_epi16(YG)));
+	y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, _mm256_set1_epi16(YB)));
+	y = _mm256_add_epi16(_mm256_srli_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(128)), 8), _mm256_set1_epi16(16));
+
+	return _mm_packus_epi16(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+}
+
+// 8 chroma values out of the 32 bit sums of 2x2 pixels
+static inline __m128i Chroma(__m256i b, __m256i g, __m256i r, int32_t cr, int32_t cg, int32_t cb) noexcept
+{
+	__m256i c = _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(cr)), _mm256_mullo_epi32(g, _mm256_set1_epi32(cg)));
+	c = _mm256_add_epi32(c, _mm256_mullo_epi32(b, _mm256_set1_epi32(cb)));
+	c = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(c, _mm256_set1_epi32(512)), 10), _mm256_set1_epi32(128));
+
+	const __m128i c16 = _mm_packs_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1));
+	return _mm_packus_epi16(c16, c16);
+}
+
+void ConvertToYUV420(const Color* pixels, size_t width, size_t height, bool invertY, uint8_t* out) noexcept
+{
+	uint8_t* planeY = out;
+	uint8_t* planeU = out + width * height;
+	uint8_t* planeV = planeU + (width / 2) * (height / 2);
+
+	__m128i mask[3][3];
+	for (int channel = 0; channel < 3; channel++)
+	{
+		for (int part = 0; part < 3; part++)
+		{
+			alignas(16) int8_t bytes[16];
+			for (int i = 0; i < 16; i++)
+			{
+				const int source = 3 * i + channel - 16 * part;
+				bytes[i] = source >= 0 && source < 16 ? static_cast<int8_t>(source) : int8_t(-128);
+			}
+			mask[channel][part] = _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+		}
+	}
+
+	const __m256i ones = _mm256_set1_epi16(1);
+
+	for (size_t y = 0; y < height; y += 2)
+	{
+		const Color* row0 = pixels + (invertY ? height - 1 - y : y) * width;
+		const Color* row1 = pixels + (invertY ? height - 2 - y : y + 1) * width;
+		uint8_t* luma0 = planeY + y * width;
+		uint8_t* luma1 = luma0 + width;
+		uint8_t* u = planeU + (y / 2) * (width / 2);
+		uint8_t* v = planeV + (y / 2) * (width / 2);
+
+		size_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b8, g8, r8;
+
+			Deinterleave(reinterpret_cast<const uint8_t*>(row0 + x), mask, b8, g8, r8);
+			const __m256i b0 = _mm256_cvtepu8_epi16(b8), g0 = _mm256_cvtepu8_epi16(g8), r0 = _mm256_cvtepu8_epi16(r8);
+
+			Deinterleave(reinterpret_cast<const uint8_t*>(row1 + x), mask, b8, g8, r8);
+			const __m256i b1 = _mm256_cvtepu8_epi16(b8), g1 = _mm256_cvtepu8_epi16(g8), r1 = _mm256_cvtepu8_epi16(r8);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(luma0 + x), Luma(b0, g0, r0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(luma1 + x), Luma(b1, g1, r1));
+
+			// vertical pairs added in 16 bits, then horizontal pairs into 32
+			const __m256i b = _mm256_madd_epi16(_mm256_add_epi16(b0, b1), ones);
+			const __m256i g = _mm256_madd_epi16(_mm256_add_epi16(g0, g1), ones);
+			const __m256i r = _mm256_madd_epi16(_mm256_add_epi16(r0, r1), ones);
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), Chroma(b, g, r, UR, UG, UB));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), Chroma(b, g, r, VR, VG, VB));
+		}
+
+		// whatever is left of the row, with the same arithmetic
+		for (; x < width; x += 2)
+		{
+			const Color quad[4] = { row0[x], row0[x + 1], row1[x], row1[x + 1] };
+			uint8_t* lumas[4] = { luma0 + x, luma0 + x + 1, luma1 + x, luma1 + x + 1 };
+			int32_t r = 0, g = 0, b = 0;
+
+			for (size_t i = 0; i < 4; i++)
+			{
+				*lumas[i] = static_cast<uint8_t>(((YR * quad[i].red + YG * quad[i].green + YB * quad[i].blue + 128) >> 8) + 16);
+				r += quad[i].red;
+				g += quad[i].green;
+				b += quad[i].blue;
+			}
+
+			u[x / 2] = ChromaOf(r, g, b, UR, UG, UB);
+			v[x / 2] = ChromaOf(r, g, b, VR, VG, VB);
+		}
+	}
+}
+
+FrameStream::FrameStream(size_t width, size_t height, StreamOptions options) : m_width(width), m_height(height), m_options(std::move(options))
+{
+	const size_t frameSize = m_options.format == StreamFormat::Y4M ? width * height + 2 * (width / 2) * (height / 2) : width * height * sizeof(Color);
+
+	for (std::vector<uint8_t>& buffer : m_buffers)
+	{
+		buffer.resize(frameSize);
+	}
+
+	m_writer = std::thread([this]() { WriterLoop(); });
+}
+
+FrameStream::~FrameStream()
+{
+	Finish();
+}
+
+void FrameStream::Finish() noexcept
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_frameQueued.notify_all();
+
+	if (m_writer.joinable())
+	{
+		m_writer.join();
+	}
+}
+
+bool FrameStream::Submit(const Color* pixels, bool invertY) noexcept
+{
+	size_t buffer = 0;
+	{
+		std::lock_guard lock(m_mutex);
+
+		if (m_queued == 2 || m_stats.failed)
+		{
+			m_stats.dropped++;
+			return false;
+		}
+		buffer = m_next;
+	}
+
+	// the writer never touches a buffer before it's queued
+	uint8_t* destination = m_buffers[buffer].data();
+
+	if (m_options.format == StreamFormat::Y4M)
+	{
+		ConvertToYUV420(pixels, m_width, m_height, invertY, destination);
+	}
+	else if (invertY)
+	{
+		const size_t rowSize = m_width * sizeof(Color);
+		for (size_t y = 0; y < m_height; y++)
+		{
+			std::memcpy(destination + y * rowSize, pixels + (m_height - 1 - y) * m_width, rowSize);
+		}
+	}
+	else
+	{
+		std::memcpy(destination, pixels, m_buffers[buffer].size());
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_next = 1 - m_next;
+		m_queued++;
+	}
+	m_frameQueued.notify_one();
+
+	return true;
+}
+
+StreamStats FrameStream::Stats() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	return m_stats;
+}
+
+bool FrameStream::Open() noexcept
+{
+	if (m_options.fileDescriptor != -1)
+	{
+#ifdef _WIN32
+		_setmode(m_options.fileDescriptor, _O_BINARY);
+		m_file = _fdopen(m_options.fileDescriptor, "wb");
+#else
+		m_file = fdopen(m_options.fileDescriptor, "wb");
+#endif
+	}
+	else
+	{
+#ifdef _WIN32
+		if (_wfopen_s(&m_file, m_options.path.c_str(), L"wb") != 0)
+		{
+			m_file = nullptr;
+		}
+#else
+		m_file = std::fopen(m_options.path.c_str(), "wb");
+#endif
+	}
+
+	if (!m_file)
+	{
+		std::cerr << "Couldn't open the stream " << (m_options.fileDescriptor != -1 ? std::to_string(m_options.fileDescriptor) : m_options.path.string()) << std::endl;
+		return false;
+	}
+
+	// the buffers already hold whole frames
+	std::setvbuf(m_file, nullptr, _IONBF, 0);
+
+	if (m_options.format == StreamFormat::Y4M)
+	{
+		const unsigned rate = static_cast<unsigned>(m_options.framesPerSecond * 1000.0f + 0.5f);
+
+		char header[96];
+		const int size = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%zu H%zu F%u:1000 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", m_width, m_height, rate);
+
+		return Write(header, static_cast<size_t>(size));
+	}
+
+	return true;
+}
+
+bool FrameStream::Write(const void* bytes, size_t size) noexcept
+{
+	if (std::fwrite(bytes, 1, size, m_file) != size)
+	{
+		std::cerr << "Failed to write to the stream, it's closed from now on" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void FrameStream::WriterLoop() noexcept
+{
+#ifndef _WIN32
+	// A reader going away has to fail the write with EPIPE instead of killing the process. Blocked on this thread only,
+	// the rest of the application keeps whatever SIGPIPE handling it has
+	sigset_t pipe;
+	sigemptyset(&pipe);
+	sigaddset(&pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+#endif
+
+	bool healthy = Open();
+
+	std::unique_lock lock(m_mutex);
+	m_stats.failed = !healthy;
+
+	while (true)
+	{
+		// when stopping, whatever was queued is still written
+		m_frameQueued.wait(lock, [this]() { return m_stop || m_queued != 0; });
+
+		if (m_queued == 0) // only reachable when stopping
+		{
+			break;
+		}
+
+		const size_t buffer = (m_next + 2 - m_queued) % 2;
+		lock.unlock();
+
+		static constexpr char FRAME[] = "FRAME\n";
+
+		if (healthy && m_options.format == StreamFormat::Y4M)
+		{
+			healthy = Write(FRAME, sizeof(FRAME) - 1);
+		}
+		if (healthy)
+		{
+			healthy = Write(m_buffers[buffer].data(), m_buffers[buffer].size());
+		}
+
+		lock.lock();
+		m_queued--;
+		healthy ? m_stats.written++ : m_stats.dropped++;
+		m_stats.failed = !healthy;
+	}
+
+	lock.unlock();
+
+	if (m_file)
+	{
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+}
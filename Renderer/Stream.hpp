@@ -0,0 +1,82 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include "Color.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class StreamFormat : uint8_t
+{
+	BGR24, // the pixels as they are, e.g. ffmpeg -f rawvideo -pix_fmt bgr24 -video_size WxH -framerate F -i <stream>
+	Y4M,   // YUV 4:2:0 with a header, half the bytes of BGR24 and every encoder reads it as is, e.g. ffmpeg -i <stream>
+};
+
+struct StreamOptions
+{
+	// A file or a named pipe (\\.\pipe\name on Windows, one made by mkfifo elsewhere). Opening a pipe waits for its reader,
+	// that happens on the writer thread so frames presented meanwhile are dropped instead
+	std::filesystem::path path;
+	int fileDescriptor = -1;       // written instead of path when it isn't -1, e.g. 1 for stdout. Closed once the stream stops
+	StreamFormat format = StreamFormat::Y4M;
+	float framesPerSecond = 60.0f; // only goes in the Y4M header, the frames are written as they're presented
+};
+
+struct StreamStats
+{
+	size_t written = 0;
+	size_t dropped = 0; // presented while both buffers were still waiting on the writer
+	bool failed = false; // the stream couldn't be opened or a write failed, the error is on the console. Everything after is dropped
+};
+
+// BT.601 limited range YUV 4:2:0, the planes back to back: width * height bytes of Y, then U and V at half the width and height.
+// Width and height have to be even, every 2x2 block of pixels shares the average of their chroma
+void ConvertToYUV420(const Color* pixels, size_t width, size_t height, bool invertY, uint8_t* out) noexcept;
+
+// Continuous video out of the presented frames, in a single stream. Submit converts or copies a frame into one of two buffers and
+// returns, a writer thread writes them in order. It never waits on the writer: with both buffers still queued the frame is dropped.
+// See Application::StartStream
+class FrameStream
+{
+public:
+	FrameStream(size_t width, size_t height, StreamOptions options);
+	~FrameStream(); // Finish
+
+	FrameStream(const FrameStream&) = delete;
+	FrameStream& operator=(const FrameStream&) = delete;
+
+	// width * height pixels, the first row at the top unless invertY. False when the frame was dropped. Only for a single thread at a time
+	bool Submit(const Color* pixels, bool invertY) noexcept;
+
+	// Writes the frames still queued and closes the stream, Submit mustn't be called anymore. Stats are final afterwards
+	void Finish() noexcept;
+
+	StreamStats Stats() const noexcept;
+
+private:
+	void WriterLoop() noexcept;
+	bool Open() noexcept;
+	bool Write(const void* bytes, size_t size) noexcept;
+
+	size_t m_width;
+	size_t m_height;
+	StreamOptions m_options;
+	FILE* m_file = nullptr; // only touched by the writer thread
+
+	// Submit fills m_buffers[m_next], the writer writes the oldest of the m_queued buffers and only counts it out once it's written
+	std::vector<uint8_t> m_buffers[2];
+	size_t m_next = 0;
+	size_t m_queued = 0;
+
+	StreamStats m_stats;
+	bool m_stop = false;
+
+	mutable std::mutex m_mutex; // of everything above but the buffers' bytes, which belong to whoever the indices say
+	std::condition_variable m_frameQueued;
+	std::thread m_writer;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+	workerCount = workerCount == 0 ? 1 : workerCount;
+	m_workers.reserve(workerCount);
+
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back([this, i]() { WorkerLoop(i); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Dispatch(size_t jobCount, const std::function<void(size_t, size_t)>& job) noexcept
+{
+	if (jobCount == 0)
+	{
+		return;
+	}
+
+	Batch batch;
+	batch.job = &job;
+	batch.count = jobCount;
+
+	std::unique_lock lock(m_mutex);
+	m_queue.push_back(&batch);
+	m_wakeUp.notify_all();
+
+	// the batch lives on this stack, so wait until no worker holds a reference to it anymore
+	m_finished.wait(lock, [&batch]() { return batch.done.load() == batch.count && batch.workers == 0; });
+}
+
+void ThreadPool::WorkerLoop(size_t workerIndex) noexcept
+{
+	std::unique_lock lock(m_mutex);
+
+	while (true)
+	{
+		m_wakeUp.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+		if (m_queue.empty()) // only reachable when stopping
+		{
+			return;
+		}
+
+		Batch* batch = m_queue.front();
+		++batch->workers;
+		lock.unlock();
+
+		while (true)
+		{
+			const size_t index = batch->next.fetch_add(1, std::memory_order_relaxed);
+			if (index >= batch->count)
+			{
+				break;
+			}
+
+			(*batch->job)(index, workerIndex);
+			batch->done.fetch_add(1, std::memory_order_acq_rel);
+		}
+
+		lock.lock();
+
+		// every job was handed out, stop others from picking this batch up
+		if (!m_queue.empty() && m_queue.front() == batch)
+		{
+			m_queue.pop_front();
+		}
+
+		if (--batch->workers == 0 && batch->done.load() == batch->count)
+		{
+			m_finished.notify_all();
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute batches of indexed jobs.
+// Dispatch() blocks the caller until every job of its batch is done, several threads may dispatch at the same time
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t workerCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// job(jobIndex, workerIndex) is called once for every jobIndex in [0, jobCount), workerIndex is in [0, WorkerCount())
+	// and is unique among the jobs running at the same time, so it can be used to index per-thread scratch memory
+	void Dispatch(size_t jobCount, const std::function<void(size_t, size_t)>& job) noexcept;
+
+	size_t WorkerCount() const noexcept { return m_workers.size(); }
+
+private:
+	struct Batch
+	{
+		const std::function<void(size_t, size_t)>* job = nullptr;
+		size_t count = 0;
+		size_t workers = 0; // guarded by m_mutex
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+	};
+
+	void WorkerLoop(size_t workerIndex) noexcept;
+
+	std::vector<std::thread> m_workers;
+	std::deque<Batch*> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	std::condition_variable m_finished;
+	bool m_stop = false;
+};
+
+#endif
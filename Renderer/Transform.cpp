@@ -0,0 +1,144 @@
+#include "Transform.hpp"
+#include <immintrin.h>
+#include <cstring>
+
+namespace
+{
+	struct TransformRows
+	{
+		__m256 m[4][4];
+	};
+
+	inline void TransformGroup(const TransformRows& rows, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, float* outW, uint8_t* outcodes) noexcept
+	{
+		const __m256 X = _mm256_loadu_ps(x);
+		const __m256 Y = _mm256_loadu_ps(y);
+		const __m256 Z = _mm256_loadu_ps(z);
+
+		__m256 out[4];
+		for (int c = 0; c < 4; c++)
+		{
+			out[c] = _mm256_fmadd_ps(X, rows.m[0][c], _mm256_fmadd_ps(Y, rows.m[1][c], _mm256_fmadd_ps(Z, rows.m[2][c], rows.m[3][c])));
+		}
+
+		_mm256_storeu_ps(outX, out[0]);
+		_mm256_storeu_ps(outY, out[1]);
+		_mm256_storeu_ps(outZ, out[2]);
+		_mm256_storeu_ps(outW, out[3]);
+
+		// same planes as ComputeOutcode, each comparison turns into its bit and the 8 codes are packed down to bytes
+		const __m256 negW = _mm256_sub_ps(_mm256_setzero_ps(), out[3]);
+		const auto bit = [](__m256 mask, int value) noexcept { return _mm256_and_si256(_mm256_castps_si256(mask), _mm256_set1_epi32(value)); };
+
+		__m256i code = bit(_mm256_cmp_ps(out[0], negW, _CMP_LT_OQ), OUTCODE_LEFT);
+		code = _mm256_or_si256(code, bit(_mm256_cmp_ps(out[0], out[3], _CMP_GT_OQ), OUTCODE_RIGHT));
+		code = _mm256_or_si256(code, bit(_mm256_cmp_ps(out[1], negW, _CMP_LT_OQ), OUTCODE_BOTTOM));
+		code = _mm256_or_si256(code, bit(_mm256_cmp_ps(out[1], out[3], _CMP_GT_OQ), OUTCODE_TOP));
+		code = _mm256_or_si256(code, bit(_mm256_cmp_ps(out[2], _mm256_setzero_ps(), _CMP_LT_OQ), OUTCODE_NEAR));
+		code = _mm256_or_si256(code, bit(_mm256_cmp_ps(out[2], out[3], _CMP_GT_OQ), OUTCODE_FAR));
+
+		// packing works per 128 bit lane, so codes 0-3 end up in the low lane and 4-7 in the high one
+		const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(code, code), _mm256_setzero_si256());
+		const uint32_t low = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(packed)));
+		const uint32_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1)));
+		memcpy(outcodes, &low, sizeof(low));
+		memcpy(outcodes + 4, &high, sizeof(high));
+	}
+
+	struct ViewPortRows
+	{
+		__m256 scale[3];
+		__m256 offset[3];
+	};
+
+	inline void ProjectGroup(const ViewPortRows& viewPort, const float* x, const float* y, const float* z, const float* w,
+		float* outX, float* outY, float* outZ, float* outInvW) noexcept
+	{
+		const __m256 invW = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_loadu_ps(w));
+		_mm256_storeu_ps(outInvW, invW);
+
+		_mm256_storeu_ps(outX, _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(x), invW), viewPort.scale[0], viewPort.offset[0]));
+		_mm256_storeu_ps(outY, _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(y), invW), viewPort.scale[1], viewPort.offset[1]));
+		_mm256_storeu_ps(outZ, _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(z), invW), viewPort.scale[2], viewPort.offset[2]));
+	}
+}
+
+void TransformPoints(const Matrix4x4f& mat, const float* x, const float* y, const float* z, size_t count,
+	float* outX, float* outY, float* outZ, float* outW, uint8_t* outcodes) noexcept
+{
+	TransformRows rows;
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			rows.m[r][c] = _mm256_set1_ps(mat.rc[r][c]);
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		TransformGroup(rows, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW + i, outcodes + i);
+	}
+
+	// the leftover points go through the same path, so a point gets the same result wherever it is in the array
+	if (i < count)
+	{
+		const size_t rest = count - i;
+		float in[3][8] = {};
+		float out[4][8];
+		uint8_t codes[8];
+
+		memcpy(in[0], x + i, rest * sizeof(float));
+		memcpy(in[1], y + i, rest * sizeof(float));
+		memcpy(in[2], z + i, rest * sizeof(float));
+
+		TransformGroup(rows, in[0], in[1], in[2], out[0], out[1], out[2], out[3], codes);
+
+		memcpy(outX + i, out[0], rest * sizeof(float));
+		memcpy(outY + i, out[1], rest * sizeof(float));
+		memcpy(outZ + i, out[2], rest * sizeof(float));
+		memcpy(outW + i, out[3], rest * sizeof(float));
+		memcpy(outcodes + i, codes, rest);
+	}
+}
+
+void ProjectPoints(const Matrix4x4f& viewPort, const ClipStreams& in, ScreenStreams& out) noexcept
+{
+	const size_t count = in.Size();
+	out.Resize(count);
+
+	ViewPortRows rows;
+	for (int c = 0; c < 3; c++)
+	{
+		rows.scale[c] = _mm256_set1_ps(viewPort.rc[c][c]);
+		rows.offset[c] = _mm256_set1_ps(viewPort.rc[3][c]);
+	}
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		ProjectGroup(rows, &in.x[i], &in.y[i], &in.z[i], &in.w[i], &out.x[i], &out.y[i], &out.z[i], &out.invW[i]);
+	}
+
+	// same as in TransformPoints, the leftover points go through the same path
+	if (i < count)
+	{
+		const size_t rest = count - i;
+		float clip[4][8] = {};
+		float screen[4][8];
+
+		memcpy(clip[0], &in.x[i], rest * sizeof(float));
+		memcpy(clip[1], &in.y[i], rest * sizeof(float));
+		memcpy(clip[2], &in.z[i], rest * sizeof(float));
+		memcpy(clip[3], &in.w[i], rest * sizeof(float));
+
+		ProjectGroup(rows, clip[0], clip[1], clip[2], clip[3], screen[0], screen[1], screen[2], screen[3]);
+
+		memcpy(&out.x[i], screen[0], rest * sizeof(float));
+		memcpy(&out.y[i], screen[1], rest * sizeof(float));
+		memcpy(&out.z[i], screen[2], rest * sizeof(float));
+		memcpy(&out.invW[i], screen[3], rest * sizeof(float));
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include "GeometricData.hpp"
+#include <cstdint>
+#include <vector>
+
+// Positions laid out as one array per component (structure of arrays), which is what the batch transform reads
+struct PointStreams
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	void Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+	}
+
+	size_t Size() const noexcept { return x.size(); }
+	Vec3f At(size_t i) const noexcept { return { x[i], y[i], z[i] }; }
+};
+
+// Homogeneous positions written by TransformPoints, along with the frustum outcode of each one
+struct ClipStreams
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> w;
+	std::vector<uint8_t> outcode;
+
+	void Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		w.resize(count);
+		outcode.resize(count);
+	}
+
+	size_t Size() const noexcept { return x.size(); }
+	Vec3f At3(size_t i) const noexcept { return { x[i], y[i], z[i] }; }
+	Vec4f At(size_t i) const noexcept { return { x[i], y[i], z[i], w[i] }; }
+};
+
+// Positions after the perspective divide and the view port mapping, with 1/w kept for perspective correct texturing
+struct ScreenStreams
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> invW;
+
+	void Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		invW.resize(count);
+	}
+
+	size_t Size() const noexcept { return x.size(); }
+};
+
+// Transforms count points by mat, 8 at a time with AVX2 + FMA. Same math as mat.Homogeneous() but nothing is divided by w,
+// the outcodes are the ones ComputeOutcode() gives, so they only mean something when mat ends with a projection.
+// Every output pointer must hold count elements, the input and output streams may not overlap
+void TransformPoints(const Matrix4x4f& mat, const float* x, const float* y, const float* z, size_t count,
+	float* outX, float* outY, float* outZ, float* outW, uint8_t* outcodes) noexcept;
+
+inline void TransformPoints(const Matrix4x4f& mat, const float* x, const float* y, const float* z, size_t count, ClipStreams& out)
+{
+	out.Resize(count);
+	TransformPoints(mat, x, y, z, count, out.x.data(), out.y.data(), out.z.data(), out.w.data(), out.outcode.data());
+}
+
+inline void TransformPoints(const Matrix4x4f& mat, const PointStreams& in, ClipStreams& out)
+{
+	TransformPoints(mat, in.x.data(), in.y.data(), in.z.data(), in.Size(), out);
+}
+
+// Divides every clip space point by its w and maps it to the screen with viewPort, 8 at a time with AVX2 + FMA. viewPort only
+// scales and offsets, as ViewPortMatrix() makes it. Points with w <= 0 come out meaningless: they're behind the camera,
+// so the clipper replaces them before anything reads them
+void ProjectPoints(const Matrix4x4f& viewPort, const ClipStreams& in, ScreenStreams& out) noexcept;
+
+// copies the positions of an interleaved vertex array into streams the batch transform can work on
+template <minVertex vertexType>
+void StagePositions(const A::array<vertexType>& vertices, PointStreams& out)
+{
+	out.Resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		out.x[i] = vertices[i].position.x;
+		out.y[i] = vertices[i].position.y;
+		out.z[i] = vertices[i].position.z;
+	}
+}
+
+// Output of the per-draw transform stage, triangles index into it so a vertex shared by several triangles is only transformed once
+struct VertexCache
+{
+	PointStreams positions; // model space, staged from the mesh
+	ClipStreams clip;
+	ScreenStreams screen;   // of every clip position, what the triangles not touched by the clipper are drawn with
+};
+
+#endif
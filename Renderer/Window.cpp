@@ -1,68 +1,255 @@
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
 #include "Window.hpp"
+#include <Windows.h>
 #include <windowsx.h>
+#include <algorithm>
 
 namespace Platform
 {
-	Window::Window(uint16_t width, uint16_t height, std::wstring_view windowName) : m_Height(height), m_Width(width)
+	// the window procedure, a friend so it can feed the input state of Window
+	struct WindowProcedure
+	{
+		static void KeyEvent(InputEvent::Type type, WPARAM vkcode) noexcept
+		{
+			Window::s_events.TryPush({ .type = type, .key = static_cast<uint8_t>(vkcode) });
+		}
+
+		static void Key(InputEvent::Type type, WPARAM vkcode) noexcept
+		{
+			Window::s_key[vkcode] = type == InputEvent::Type::KEY_DOWN;
+			KeyEvent(type, vkcode);
+		}
+
+		static LRESULT CALLBACK MsgHandling(_In_ HWND hWND, _In_ UINT Msg, _In_ WPARAM wParam, _In_ LPARAM lParam)
+		{
+			switch (Msg)
+			{
+				case WM_DESTROY:
+				{
+					PostQuitMessage(0);
+					return 0;
+				}
+				case WM_CLOSE:
+				{
+					PostQuitMessage(0);
+					return 0;
+				}
+				case WM_QUIT:
+				{
+					PostQuitMessage(0);
+					return 0;
+				}
+
+				// keyboard
+				case WM_KEYDOWN: Key(InputEvent::Type::KEY_DOWN, wParam); return 0;
+
+				case WM_KEYUP: Key(InputEvent::Type::KEY_UP, wParam); return 0;
+
+				// mouse
+				case WM_MOUSEMOVE:
+				{
+					Window::s_mousePos[0] = static_cast<int16_t>(GET_X_LPARAM(lParam));
+					Window::s_mousePos[1] = static_cast<int16_t>(GET_Y_LPARAM(lParam));
+					Window::s_events.TryPush({ .type = InputEvent::Type::MOUSE_MOVE, .x = Window::s_mousePos[0], .y = Window::s_mousePos[1] });
+					return 0;
+				}
+
+				case WM_LBUTTONDOWN: Key(InputEvent::Type::KEY_DOWN, VK_LBUTTON); return 0;
+
+				case WM_LBUTTONUP: Key(InputEvent::Type::KEY_UP, VK_LBUTTON); return 0;
+
+				case WM_MBUTTONDOWN: Key(InputEvent::Type::KEY_DOWN, VK_MBUTTON); return 0;
+
+				case WM_MBUTTONUP: Key(InputEvent::Type::KEY_UP, VK_MBUTTON); return 0;
+
+				case WM_RBUTTONDOWN: Key(InputEvent::Type::KEY_DOWN, VK_RBUTTON); return 0;
+
+				case WM_RBUTTONUP: Key(InputEvent::Type::KEY_UP, VK_RBUTTON); return 0;
+
+				case WM_MOUSEWHEEL:
+				{
+					Window::s_mouseWheel = GET_WHEEL_DELTA_WPARAM(wParam);
+					Window::s_events.TryPush({ .type = InputEvent::Type::MOUSE_WHEEL, .wheel = Window::s_mouseWheel });
+					return 0;
+				}
+
+			}
+			return DefWindowProc(hWND, Msg, wParam, lParam);
+		}
+	};
+
+	Window::Window(uint16_t width, uint16_t height, std::wstring_view windowName) : m_Width(width), m_Height(height)
 	{
 		WNDCLASSEX wc = { };
 
 		wc.cbSize = sizeof(WNDCLASSEX);
-		wc.lpfnWndProc = MsgHandling;
-		wc.hInstance = this->m_hInstance;
+		wc.lpfnWndProc = WindowProcedure::MsgHandling;
+		wc.hInstance = static_cast<HINSTANCE>(m_hInstance);
 		wc.lpszClassName = L"ApplicationProgram";
 
 		RegisterClassEx(&wc);
-        m_hwnd = CreateWindowExW(0, L"ApplicationProgram", windowName.data(), WS_OVERLAPPED | WS_SYSMENU, CW_USEDEFAULT, CW_USEDEFAULT, width, height, nullptr, nullptr, this->m_hInstance, nullptr);
+		const HWND hwnd = CreateWindowExW(0, L"ApplicationProgram", windowName.data(), WS_OVERLAPPED | WS_SYSMENU, CW_USEDEFAULT, CW_USEDEFAULT, width, height, nullptr, nullptr, static_cast<HINSTANCE>(m_hInstance), nullptr);
 
-        ShowWindow(m_hwnd, SW_SHOWNORMAL);
+		ShowWindow(hwnd, SW_SHOWNORMAL);
 
-		m_hdc = GetDC(m_hwnd);
+		m_hwnd = hwnd;
+		m_hdc = GetDC(hwnd);
 	}
-	
-	LRESULT Window::MsgHandling(_In_ HWND hWND, _In_ UINT Msg, _In_ WPARAM wParam, _In_ LPARAM lParam)
+
+	Window::~Window()
 	{
-		switch (Msg)
+		for (const BackBuffer& buffer : m_backBuffers)
+		{
+			SelectObject(static_cast<HDC>(buffer.dc), static_cast<HGDIOBJ>(buffer.previousBitmap));
+			DeleteObject(static_cast<HGDIOBJ>(buffer.bitmap));
+			DeleteDC(static_cast<HDC>(buffer.dc));
+		}
+
+		if (m_hwnd && m_hdc)
 		{
-			case WM_DESTROY:
+			ReleaseDC(static_cast<HWND>(m_hwnd), static_cast<HDC>(m_hdc));
+		}
+	}
+
+	bool Window::ProcessEvents() noexcept
+	{
+		MSG msg = {};
+
+		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+		{
+			if (msg.message == WM_QUIT) [[unlikely]]
 			{
-				PostQuitMessage(0); 
-				return 0;
+				return false;
 			}
-			case WM_CLOSE:
+
+			TranslateMessage(&msg);
+			DispatchMessageW(&msg);
+		}
+
+		return true;
+	}
+
+	float Window::FrameTime() noexcept
+	{
+		const auto now = std::chrono::high_resolution_clock::now();
+		if (m_lastFrame == std::chrono::high_resolution_clock::time_point{})
+		{
+			m_lastFrame = now;
+		}
+
+		const auto elapsed = now - m_lastFrame;
+		m_lastFrame = now;
+
+		return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / 1000.0f;
+	}
+
+	void Window::Present(const Color* pixels, size_t width, size_t height, bool invertY) noexcept
+	{
+		const auto buffer = std::find_if(m_backBuffers.begin(), m_backBuffers.end(), [pixels](const BackBuffer& b) { return b.pixels == pixels; });
+
+		if (buffer != m_backBuffers.end())
+		{
+			const int w = static_cast<int>(width);
+			const int h = static_cast<int>(height);
+
+			// the sections are top-down, a negative height mirrors the blit when the first row has to end up at the bottom
+			if (invertY)
 			{
-				PostQuitMessage(0);
-				return 0;
+				StretchBlt(static_cast<HDC>(m_hdc), 0, h - 1, w, -h, static_cast<HDC>(buffer->dc), 0, 0, w, h, SRCCOPY);
 			}
-			case WM_QUIT:
+			else
 			{
-				PostQuitMessage(0);
-				return 0;
+				BitBlt(static_cast<HDC>(m_hdc), 0, 0, w, h, static_cast<HDC>(buffer->dc), 0, 0, SRCCOPY);
 			}
 
-			// keyboard
-			case WM_KEYDOWN: s_key[wParam] = true; return 0;
-
-			case WM_KEYUP: s_key[wParam] = false; return 0;
-
-			// mouse
-			case WM_MOUSEMOVE: s_mousePos[0] = GET_X_LPARAM(lParam); s_mousePos[1] = GET_Y_LPARAM(lParam); return 0;
+			// GDI may batch the blit, it has to be done before the rasterizer draws into this buffer again
+			GdiFlush();
+			return;
+		}
 
-			case WM_LBUTTONDOWN: s_key[VK_LBUTTON] = true; return 0;
+		// any other pixels go through a conversion into a DIB of GDI's own
+		const BITMAPINFO bmi =
+		{
+			.bmiHeader = {.biSize = sizeof(bmi.bmiHeader),
+			.biWidth = static_cast<LONG>(width),
+			.biHeight = static_cast<LONG>(invertY ? static_cast<int16_t>(height) : -static_cast<int16_t>(height)),
+			.biPlanes = 1,
+			.biBitCount = 24,
+			.biCompression = BI_RGB
+		}};
+
+		SetDIBitsToDevice
+		(
+			static_cast<HDC>(m_hdc),
+			0,
+			0,
+			(int16_t)width,
+			(int16_t)height,
+			0,
+			0,
+			0,
+			(int16_t)height,
+			pixels,
+			&bmi,
+			DIB_RGB_COLORS
+		);
+	}
 
-			case WM_LBUTTONUP: s_key[VK_LBUTTON] = false; return 0;
+	Color* Window::CreateBackBuffer([[maybe_unused]] size_t index, size_t width, size_t height) noexcept
+	{
+		// 24 bits per pixel like Color, rows are padded to 4 bytes but the canvas width is a multiple of 4 so there's no padding
+		const BITMAPINFO bmi =
+		{
+			.bmiHeader = {.biSize = sizeof(bmi.bmiHeader),
+			.biWidth = static_cast<LONG>(width),
+			.biHeight = -static_cast<LONG>(height), // top-down
+			.biPlanes = 1,
+			.biBitCount = 24,
+			.biCompression = BI_RGB
+		}};
+
+		if ((width * sizeof(Color)) % sizeof(DWORD) != 0)
+		{
+			return nullptr;
+		}
 
-			case WM_MBUTTONDOWN: s_key[VK_MBUTTON] = true; return 0;
+		void* pixels = nullptr;
+		const HBITMAP bitmap = CreateDIBSection(static_cast<HDC>(m_hdc), &bmi, DIB_RGB_COLORS, &pixels, nullptr, 0);
+		if (!bitmap || !pixels)
+		{
+			return nullptr;
+		}
 
-			case WM_MBUTTONUP: s_key[VK_MBUTTON] = false; return 0;
+		const HDC dc = CreateCompatibleDC(static_cast<HDC>(m_hdc));
+		if (!dc)
+		{
+			DeleteObject(bitmap);
+			return nullptr;
+		}
 
-			case WM_RBUTTONDOWN: s_key[VK_RBUTTON] = true; return 0;
+		m_backBuffers.push_back({ .pixels = static_cast<Color*>(pixels), .bitmap = bitmap, .previousBitmap = SelectObject(dc, bitmap), .dc = dc });
 
-			case WM_RBUTTONUP: s_key[VK_RBUTTON] = false; return 0;
+		return static_cast<Color*>(pixels);
+	}
 
-			case WM_MOUSEWHEEL: s_mouseWheel = GET_WHEEL_DELTA_WPARAM(wParam); return 0;
+	void Window::SetTitle(std::wstring_view name) noexcept
+	{
+		SetWindowTextW(static_cast<HWND>(m_hwnd), name.data());
+	}
 
-		}
-		return DefWindowProc(hWND, Msg, wParam, lParam);
+	void Window::SetTitle(std::string_view name) noexcept
+	{
+		SetWindowTextA(static_cast<HWND>(m_hwnd), name.data());
 	}
 };
+
+#endif
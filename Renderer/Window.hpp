@@ -1,44 +1,62 @@
 #ifndef WINDOW_HPP
 #define WINDOW_HPP
 
-#ifndef NO_MIN_MAX
-#define NO_MIN_MAX
-#endif
-
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-
-#include "Windows.h"
+#include "Platform.hpp"
+#include "LockFree.hpp"
+#include <chrono>
 #include <iostream>
+#include <vector>
 
-class Application;
 namespace Platform
 {
-	class Window
+	// Win32 window backend, only built on Windows. Win32 itself stays in Window.cpp, handles are kept as void*
+	class Window final : public Backend
 	{
-		friend class Application;
+		friend struct WindowProcedure;
 	public:
 		explicit Window(uint16_t Width = 800, uint16_t Height = 600, std::wstring_view windowName = L"Default Window");
+		~Window() override;
+
+		bool ProcessEvents() noexcept override;
+		float FrameTime() noexcept override;
+		void Present(const Color* pixels, size_t width, size_t height, bool invertY) noexcept override;
+		Color* CreateBackBuffer(size_t index, size_t width, size_t height) noexcept override;
+		void SetTitle(std::wstring_view name) noexcept override;
+		void SetTitle(std::string_view name) noexcept override;
 
 		inline static int16_t GetMouseX() noexcept { return s_mousePos[0]; }
 		inline static int16_t GetMouseY() noexcept { return s_mousePos[1]; }
 		inline static int32_t GetMouseWheelTurn() noexcept { return s_mouseWheel; }
 		inline static const bool KeyDown(uint8_t vkcode) noexcept { return s_key[vkcode]; }
 
+		// The same input as a stream of events, for a single consumer thread other than the one pumping messages (see
+		// Application::SetSimulationRate). Events are dropped while the queue is full, so it has to be drained regularly
+		inline static bool PollEvent(InputEvent& event) noexcept { return s_events.TryPop(event); }
+
 	private:
 		uint16_t m_Width;
 		uint16_t m_Height;
-		HINSTANCE m_hInstance = nullptr;
-		HWND m_hwnd = nullptr;
-		HDC m_hdc = nullptr;
-
-		static LRESULT CALLBACK MsgHandling(_In_ HWND hWnd, _In_ UINT Msg, _In_ WPARAM wParam, _In_ LPARAM lParam);
+		void* m_hInstance = nullptr;
+		void* m_hwnd = nullptr;
+		void* m_hdc = nullptr;
+		std::chrono::high_resolution_clock::time_point m_lastFrame; // of the last FrameTime call, the first one starts the clock
+
+		// Back buffers made as DIB sections, the rasterizer draws straight into memory GDI can blit from. Each one stays selected
+		// into a memory DC of its own, so presenting one is a single BitBlt without converting or copying it anywhere first
+		struct BackBuffer
+		{
+			const Color* pixels = nullptr;
+			void* bitmap = nullptr;
+			void* previousBitmap = nullptr; // of the memory DC, put back before deleting it
+			void* dc = nullptr;
+		};
+		std::vector<BackBuffer> m_backBuffers;
 
 		inline static bool s_key[256] = {};
 		inline static int16_t s_mousePos[2] = {};
 		inline static int32_t s_mouseWheel = {};
+		inline static SPSCQueue<InputEvent, 1024> s_events;
 	};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -29,7 +29,7 @@ public:
 private:
 	void OnUpdate([[maybe_unused]] float dt) noexcept override
 	{
-		SetWindowTitle("Birdie, FPS: " + std::to_string(FPS()));
+		SetWindowTitle("Birdie, FPS: " + std::to_string(FPS()) + ", present: " + std::to_string(PresentTime()) + " ms");
 
 		//// use this syntax for calling function members
 		// const auto lambda = [this](uint16_t x, uint16_t y) -> Color { return pixelShader(x, y); };
@@ -43,32 +43,32 @@ private:
 		// Use arrow keys for camera rotation and WASD for movement, CTRL and SHIFT are also used to travel upwards and downwards
 
 		const float step = 30.0f * dt;
-		if (Platform::Window::KeyDown(VK_SHIFT))
+		if (Platform::Window::KeyDown(Platform::Key::SHIFT))
 		{
 			camera.position.y += step; // Travel Downwards
 		}
 
-		if (Platform::Window::KeyDown(VK_CONTROL))
+		if (Platform::Window::KeyDown(Platform::Key::CONTROL))
 		{
 			camera.position.y -= step; // Travel Upwards
 		}
 
-		if (Platform::Window::KeyDown(VK_LEFT))
+		if (Platform::Window::KeyDown(Platform::Key::LEFT))
 		{
 			camera.rotation.y += 3.0f * step;
 		}
 
-		if (Platform::Window::KeyDown(VK_RIGHT))
+		if (Platform::Window::KeyDown(Platform::Key::RIGHT))
 		{
 			camera.rotation.y -= 3.0f * step;
 		}
 
-		if (Platform::Window::KeyDown(VK_UP))
+		if (Platform::Window::KeyDown(Platform::Key::UP))
 		{
 			camera.rotation.x += 3.0f * step;
 		}
 
-		if (Platform::Window::KeyDown(VK_DOWN))
+		if (Platform::Window::KeyDown(Platform::Key::DOWN))
 		{
 			camera.rotation.x -= 3.0f * step;
 		}